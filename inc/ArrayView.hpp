@@ -0,0 +1,41 @@
+#ifndef SV_ALIGN_ARRAYVIEW_HPP
+#define SV_ALIGN_ARRAYVIEW_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+using std::runtime_error;
+
+
+template<class T> class ArrayView {
+    ///
+    /// Non-owning, read-only view of a contiguous array, typically a section of a memory mapped file
+    ///
+
+public:
+    /// Attributes ///
+    const T* pointer;
+    size_t length;
+
+    /// Methods ///
+    ArrayView(): pointer(nullptr), length(0) {}
+    ArrayView(const T* pointer, size_t length): pointer(pointer), length(length) {}
+
+    const T& operator[](size_t i) const {return this->pointer[i];}
+    const T& at(size_t i) const {
+        if (i >= this->length){
+            throw runtime_error("ERROR: index " + std::to_string(i) + " out of range for view of size " + std::to_string(this->length));
+        }
+        return this->pointer[i];
+    }
+    const T& back() const {return this->pointer[this->length - 1];}
+    const T* begin() const {return this->pointer;}
+    const T* end() const {return this->pointer + this->length;}
+    const T* data() const {return this->pointer;}
+    size_t size() const {return this->length;}
+    bool empty() const {return this->length == 0;}
+};
+
+
+#endif //SV_ALIGN_ARRAYVIEW_HPP
@@ -0,0 +1,64 @@
+#ifndef SV_ALIGN_BGZFREADER_HPP
+#define SV_ALIGN_BGZFREADER_HPP
+
+#include "ArrayView.hpp"
+#include <experimental/filesystem>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+
+using std::experimental::filesystem::path;
+using std::unordered_map;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+using std::mutex;
+using std::pair;
+
+
+class BGZFReader {
+public:
+    ///
+    /// Random access to the uncompressed contents of a BGZF file (bgzip, as used for GAM, BAM and tabix). A BGZF
+    /// file is a series of independent gzip blocks of at most 64 KiB uncompressed each. The block table lists where
+    /// every block starts, both in the compressed file and in the uncompressed stream, so that any uncompressed
+    /// offset can be converted to a block and decompressed on its own.
+    ///
+    /// Reads are const and thread-safe. Recently used blocks are kept in a small cache shared by all threads.
+    ///
+
+    /// Attributes ///
+    path file_path;
+    int file_descriptor;
+    vector <uint64_t> compressed_offsets;       // Start of each block in the file, plus the file size
+    vector <uint64_t> uncompressed_offsets;     // Start of each block in the uncompressed stream, plus its size
+    size_t max_cached_blocks;
+    mutable mutex cache_mutex;
+    mutable unordered_map <size_t, pair <shared_ptr <const string>, uint64_t> > cached_blocks;
+    mutable uint64_t cache_clock;
+
+    /// Methods ///
+    BGZFReader(path file_path, size_t max_cached_blocks=64);
+    BGZFReader(const BGZFReader& other) = delete;
+    BGZFReader& operator=(const BGZFReader& other) = delete;
+    ~BGZFReader();
+    static bool is_bgzf(const char* data, uint64_t size);
+    static bool is_gzip(const char* data, uint64_t size);
+    void index_blocks();
+    void load_blocks(ArrayView <uint64_t> compressed_offsets, ArrayView <uint64_t> uncompressed_offsets);
+    size_t get_block_count() const;
+    uint64_t get_uncompressed_size() const;
+    size_t find_block(uint64_t uncompressed_offset) const;
+    uint64_t get_virtual_offset(uint64_t uncompressed_offset) const;
+    uint64_t get_uncompressed_offset(uint64_t virtual_offset) const;
+    void decompress_all(vector <char>& data, size_t n_threads) const;
+    void decompress_blocks(size_t first_block, size_t stop_block, char* destination, size_t n_threads) const;
+    shared_ptr <const string> get_block(size_t block_index) const;
+    void read(uint64_t offset, uint64_t length, string& s) const;
+    void read(uint64_t offset, uint64_t length, char* destination) const;
+};
+
+
+#endif //SV_ALIGN_BGZFREADER_HPP
@@ -11,10 +11,14 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <cstring>
+#include <string_view>
+#include <type_traits>
+#include <algorithm>
 
 using std::ostream;
 using std::istream;
 using std::string;
+using std::string_view;
 using std::cout;
 using std::cerr;
 using std::vector;
@@ -49,7 +53,7 @@ template<class T> void read_value_from_binary(istream& s, T& v){
     ///
     /// Without worrying about size conversions, read any value from a file using istream.read
     ///
-    cout << "Reading value size of: " << sizeof(T) << " at position: " << s.tellg() << '\n';
+
     s.read(reinterpret_cast<char*>(&v), sizeof(T));
 }
 
@@ -58,7 +62,6 @@ template<class T> void read_vector_from_binary(istream& s, vector<T>& v, uint64_
     ///
     /// Without worrying about size conversions, read any vector from a file using istream.read
     ///
-    cout << "Reading vector of size: " << sizeof(T)*length << " at position: " << s.tellg() << '\n';
 
     v.resize(length);
     s.read(reinterpret_cast<char*>(v.data()), sizeof(T)*length);
@@ -97,4 +100,142 @@ template<class T> void pread_vector_from_binary(int file_descriptor, vector<T>&
 }
 
 
+template<class T> T to_little_endian(T v){
+    ///
+    /// Byte order of everything written by BinaryWriter. Converting is its own inverse, so this also decodes.
+    ///
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    auto bytes = reinterpret_cast<char*>(&v);
+    std::reverse(bytes, bytes + sizeof(T));
+#endif
+
+    return v;
+}
+
+
+uint64_t encode_zigzag(int64_t v);
+
+int64_t decode_zigzag(uint64_t v);
+
+
+class BinaryWriter{
+public:
+    ///
+    /// Buffered serializer on top of an ostream, so that writing a field costs a copy, not a stream call. Fixed width
+    /// values are little-endian. Integers can also be written as varints (LEB128, 7 bits per byte), and signed ones
+    /// zigzag encoded first so that small negative values stay short. Strings and vectors are prefixed with their
+    /// length as a varint. The buffer is flushed when full, on flush(), and on destruction.
+    ///
+
+    /// Attributes ///
+    ostream& stream;
+    vector <char> buffer;
+    size_t buffer_size;
+    uint64_t n_flushed;
+    static const size_t DEFAULT_BUFFER_SIZE;
+
+    /// Methods ///
+    explicit BinaryWriter(ostream& stream, size_t buffer_size=DEFAULT_BUFFER_SIZE);
+    BinaryWriter(const BinaryWriter& other) = delete;
+    BinaryWriter& operator=(const BinaryWriter& other) = delete;
+    ~BinaryWriter();
+    void write_bytes(const char* data, size_t size);
+    template<class T> void write_value(T v);
+    void write_varint(uint64_t v);
+    void write_zigzag(int64_t v);
+    void write_string(string_view s);
+    template<class T> void write_vector(const vector<T>& v);
+    uint64_t tell() const;
+    void flush();
+};
+
+
+template<class T> void BinaryWriter::write_value(T v){
+    static_assert(std::is_arithmetic<T>::value or std::is_enum<T>::value, "BinaryWriter::write_value requires a numeric type");
+
+    v = to_little_endian(v);
+    this->write_bytes(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+
+template<class T> void BinaryWriter::write_vector(const vector<T>& v){
+    static_assert(std::is_arithmetic<T>::value, "BinaryWriter::write_vector requires a numeric type");
+
+    this->write_varint(v.size());
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (auto& item: v){
+        this->write_value(item);
+    }
+#else
+    this->write_bytes(reinterpret_cast<const char*>(v.data()), v.size()*sizeof(T));
+#endif
+}
+
+
+class BinaryReader{
+public:
+    ///
+    /// Buffered deserializer for the format of BinaryWriter, with three sources:
+    ///     istream:            read in buffer sized chunks
+    ///     file descriptor:    pread in buffer sized chunks from a starting offset, threadsafe with other readers
+    ///     memory:             a span such as a memory mapped file, used in place without copying
+    /// Reading past the end of the source throws.
+    ///
+
+    /// Attributes ///
+    istream* stream;
+    int file_descriptor;
+    off_t file_offset;
+    vector <char> buffer;
+    const char* chunk;          // Start of the data currently being read, in the buffer or in memory
+    const char* cursor;
+    const char* end;
+    uint64_t chunk_offset;      // Position of the chunk in the source
+    static const size_t DEFAULT_BUFFER_SIZE;
+
+    /// Methods ///
+    explicit BinaryReader(istream& stream, size_t buffer_size=DEFAULT_BUFFER_SIZE);
+    BinaryReader(int file_descriptor, off_t offset, size_t buffer_size=DEFAULT_BUFFER_SIZE);
+    BinaryReader(const char* data, size_t size);
+    BinaryReader(const BinaryReader& other) = delete;
+    BinaryReader& operator=(const BinaryReader& other) = delete;
+    bool refill();
+    bool at_end();
+    void read_bytes(char* data, size_t size);
+    template<class T> void read_value(T& v);
+    void read_varint(uint64_t& v);
+    void read_zigzag(int64_t& v);
+    void read_string(string& s);
+    template<class T> void read_vector(vector<T>& v);
+    uint64_t tell() const;
+};
+
+
+template<class T> void BinaryReader::read_value(T& v){
+    static_assert(std::is_arithmetic<T>::value or std::is_enum<T>::value, "BinaryReader::read_value requires a numeric type");
+
+    this->read_bytes(reinterpret_cast<char*>(&v), sizeof(T));
+    v = to_little_endian(v);
+}
+
+
+template<class T> void BinaryReader::read_vector(vector<T>& v){
+    static_assert(std::is_arithmetic<T>::value, "BinaryReader::read_vector requires a numeric type");
+
+    uint64_t length;
+    this->read_varint(length);
+
+    v.resize(length);
+    this->read_bytes(reinterpret_cast<char*>(v.data()), length*sizeof(T));
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    for (auto& item: v){
+        item = to_little_endian(item);
+    }
+#endif
+}
+
+
 #endif //RUNLENGTH_ANALYSIS_BINARYIO_HPP
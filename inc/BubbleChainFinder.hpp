@@ -0,0 +1,56 @@
+#ifndef SV_ALIGN_BUBBLECHAINFINDER_HPP
+#define SV_ALIGN_BUBBLECHAINFINDER_HPP
+
+#include "BubbleChain.hpp"
+#include "GFAReader.hpp"
+#include <vector>
+
+using std::vector;
+
+
+// A node traversed in one orientation, encoded as handle*2 + reversed
+typedef uint64_t OrientedNode;
+
+
+class Superbubble{
+public:
+    ///
+    /// Subgraph between an entrance and an exit (Onodera et al. 2013): every path leaving the entrance reaches the
+    /// exit, every path reaching the exit comes from the entrance, the interior is acyclic, and no smaller exit exists
+    ///
+
+    /// Attributes ///
+    OrientedNode entrance;
+    OrientedNode exit;
+    vector <NodeHandle> interior;
+};
+
+
+class BubbleChainFinder{
+public:
+    ///
+    /// Native replacement for Shasta's BubbleChains.csv: finds the superbubbles of a GFA from its in-memory adjacency
+    /// and links them into chains, where the exit of each bubble is the entrance of the next. Each chain is reported
+    /// once, on one strand, as a list of BubbleChainComponent: the entrance and exit segments are haploid components
+    /// and the interior of each bubble is one polyploid component.
+    ///
+
+    /// Attributes ///
+    const GFAReader& gfa_reader;
+    size_t n_threads;
+    size_t max_bubble_size;                     // 0 for no limit
+    static const size_t DEFAULT_MAX_BUBBLE_SIZE;
+
+    /// Methods ///
+    BubbleChainFinder(const GFAReader& gfa_reader, size_t n_threads, size_t max_bubble_size=DEFAULT_MAX_BUBBLE_SIZE);
+    void get_children(OrientedNode v, vector <OrientedNode>& children) const;
+    void get_parents(OrientedNode v, vector <OrientedNode>& parents) const;
+    bool find_superbubble(OrientedNode entrance, Superbubble& superbubble, bool& is_abandoned) const;
+    void find_connected_components(vector <uint32_t>& component_of_node, size_t& n_components) const;
+    void link_superbubbles(vector <Superbubble>& superbubbles, vector <vector <BubbleChainComponent> >& chains) const;
+    void find_bubble_chains(vector <vector <BubbleChainComponent> >& chains, size_t& n_abandoned_entrances) const;
+    void find_bubble_chains(vector <vector <BubbleChainComponent> >& chains) const;
+};
+
+
+#endif //SV_ALIGN_BUBBLECHAINFINDER_HPP
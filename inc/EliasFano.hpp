@@ -0,0 +1,87 @@
+#ifndef SV_ALIGN_ELIASFANO_HPP
+#define SV_ALIGN_ELIASFANO_HPP
+
+#include "ArrayView.hpp"
+#include <iterator>
+#include <vector>
+
+using std::vector;
+
+
+class EliasFano{
+public:
+    ///
+    /// Compressed, randomly accessible encoding of a non-decreasing sequence of n integers below u. Each value is
+    /// split into its low log2(u/n) bits, stored verbatim, and its high bits, stored in unary as gaps in a bitvector
+    /// of about 2n bits, for a total of about 2 + log2(u/n) bits per value. Access finds the i-th set bit of the
+    /// high bitvector, starting from a sample taken every SAMPLE_RATE set bits, so it reads a few words at most.
+    ///
+    /// Everything is stored in one array of 64 bit words, which can be used in place from a memory mapped index:
+    ///     n, low bit width, number of low words, number of high words, number of samples, low, high, samples
+    ///
+
+    /// Attributes ///
+    uint64_t n;
+    uint64_t low_bits;
+    ArrayView <uint64_t> low;
+    ArrayView <uint64_t> high;
+    ArrayView <uint64_t> samples;
+    static const uint64_t SAMPLE_RATE;
+
+    /// Methods ///
+    EliasFano();
+    static void encode(const uint64_t* values, size_t n, vector <uint64_t>& words);
+    void load(ArrayView <uint64_t> words);
+    uint64_t operator[](size_t i) const;
+    size_t size() const;
+};
+
+
+class MonotoneView{
+public:
+    ///
+    /// Read-only view of a non-decreasing array of uint64, either plain (e.g. a section of a mapped file) or Elias-Fano
+    /// encoded, so that code reading offsets does not need to know how the index was written
+    ///
+
+    class const_iterator{
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef uint64_t value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const uint64_t* pointer;
+        typedef uint64_t reference;
+
+        /// Attributes ///
+        const MonotoneView* view;
+        size_t i;
+
+        /// Methods ///
+        uint64_t operator*() const {return (*this->view)[this->i];}
+        const_iterator& operator++() {this->i++; return *this;}
+        const_iterator operator+(difference_type d) const {return {this->view, size_t(difference_type(this->i) + d)};}
+        difference_type operator-(const const_iterator& other) const {return difference_type(this->i) - difference_type(other.i);}
+        bool operator==(const const_iterator& other) const {return this->i == other.i;}
+        bool operator!=(const const_iterator& other) const {return this->i != other.i;}
+    };
+
+    /// Attributes ///
+    ArrayView <uint64_t> plain;
+    EliasFano compressed;
+    bool is_compressed;
+
+    /// Methods ///
+    MonotoneView();
+    MonotoneView(ArrayView <uint64_t> plain);
+    MonotoneView(const EliasFano& compressed);
+    uint64_t operator[](size_t i) const {return this->is_compressed ? this->compressed[i] : this->plain[i];}
+    uint64_t at(size_t i) const;
+    uint64_t back() const;
+    size_t size() const;
+    bool empty() const;
+    const_iterator begin() const {return {this, 0};}
+    const_iterator end() const {return {this, this->size()};}
+};
+
+
+#endif //SV_ALIGN_ELIASFANO_HPP
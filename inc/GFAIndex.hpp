@@ -0,0 +1,234 @@
+#ifndef SV_ALIGN_GFAINDEX_HPP
+#define SV_ALIGN_GFAINDEX_HPP
+
+#include "ArrayView.hpp"
+#include "EliasFano.hpp"
+#include <string_view>
+#include <string>
+#include <vector>
+#include <map>
+
+using std::string_view;
+using std::string;
+using std::vector;
+using std::map;
+
+
+///
+/// Data types shared by the GFA indexer, which writes .gfai files, and the GFAReader, which serves queries from them
+///
+
+
+// Dense identifier of a node, assigned by position in the sorted node table
+typedef uint32_t NodeHandle;
+
+
+class GFAEdge{
+public:
+    ///
+    /// One entry of the adjacency list of a node, representing one side of an L line. Traversing this node in
+    /// orientation `reversed` leads to `neighbor` in orientation `neighbor_reversed`. Every L line produces an entry
+    /// for each of its nodes, the second being the same link seen in the opposite direction. Orientations are 0
+    /// (forward) or 1 (reverse), stored as full words so the struct has no padding.
+    ///
+
+    /// Attributes ///
+    uint64_t line_index;
+    NodeHandle neighbor;
+    uint32_t overlap_length;        // Number of bases of this node covered by the overlap
+    uint32_t reversed;
+    uint32_t neighbor_reversed;
+};
+
+
+class GFAIndex{
+public:
+    /// Attributes ///
+    char type;
+    uint64_t offset;
+
+    /// Methods ///
+    GFAIndex(char type, uint64_t offset);
+};
+
+
+class GFALineOffsets{
+public:
+    ///
+    /// Columnar view of the line index: one type code and one byte offset per line, plus a trailing EOF entry. The
+    /// offsets are Elias-Fano encoded if the index was built with compressed offsets.
+    ///
+
+    /// Attributes ///
+    ArrayView <char> types;
+    MonotoneView offsets;
+
+    /// Methods ///
+    GFAIndex operator[](size_t i) const;
+    GFAIndex back() const;
+    size_t size() const;
+};
+
+
+class GFASourceStamp{
+public:
+    ///
+    /// Identity of the GFA an index was built from, used to detect indexes that no longer describe their GFA
+    ///
+
+    /// Attributes ///
+    uint64_t file_size;
+    int64_t mtime_seconds;
+    int64_t mtime_nanoseconds;
+    uint64_t checksum;
+};
+
+
+class GFAIndexBuffers{
+public:
+    ///
+    /// Everything that is written to a .gfai, accumulated in memory while indexing. For a BGZF compressed GFA, all
+    /// offsets are positions in the uncompressed text, and the block table converts them to file positions.
+    ///
+
+    /// Attributes ///
+    vector <char> types;
+    vector <uint64_t> offsets;
+    map <char, vector <uint64_t> > lines_by_type;
+    vector <char> node_names;
+    vector <uint64_t> node_name_bounds;
+    vector <uint64_t> node_sequence_lines;
+    vector <uint64_t> node_link_bounds;
+    vector <uint64_t> node_link_lines;
+    vector <int64_t> node_id_offset;
+    vector <NodeHandle> node_handles_by_id;
+    vector <uint64_t> adjacency_bounds;
+    vector <GFAEdge> adjacency_edges;
+    vector <uint64_t> sequence_lengths;
+    vector <uint64_t> bgzf_compressed_offsets;
+    vector <uint64_t> bgzf_uncompressed_offsets;
+    GFASourceStamp source_stamp;
+};
+
+
+class GFANodeTable{
+public:
+    ///
+    /// Node names sorted lexicographically, stored as one contiguous pool, with the S line and L lines of each node.
+    /// The position of a name in the table is its NodeHandle. If every name is an integer (e.g. Shasta graphs), a
+    /// direct id -> handle table is also stored, so integer ids can be resolved without formatting or comparing names.
+    ///
+
+    /// Attributes ///
+    ArrayView <char> names;
+    ArrayView <uint64_t> name_bounds;
+    ArrayView <uint64_t> sequence_lines;
+    ArrayView <uint64_t> link_bounds;
+    ArrayView <uint64_t> link_lines;
+    ArrayView <int64_t> id_offset;
+    ArrayView <NodeHandle> handles_by_id;
+    static const uint64_t NO_LINE;
+    static const NodeHandle NO_HANDLE;
+
+    /// Methods ///
+    size_t size() const;
+    string_view get_name(NodeHandle handle) const;
+    bool find(string_view name, NodeHandle& handle) const;
+    bool find(int64_t id, NodeHandle& handle) const;
+    ArrayView <uint64_t> get_link_lines(NodeHandle handle) const;
+};
+
+
+class GFATagColumnBuffers{
+public:
+    ///
+    /// Owned storage for a tag column that was just extracted, and which is not yet part of a mapped index
+    ///
+
+    /// Attributes ///
+    vector <uint8_t> present;
+    vector <int64_t> integers;
+    vector <double> floats;
+    vector <char> strings;
+    vector <uint64_t> string_bounds;
+};
+
+
+class GFATagColumn{
+public:
+    ///
+    /// One optional field (e.g. RC:i) of every line of one type, in the order of that type's line list. Integer tags
+    /// ('i') are stored as int64 and float tags ('f') as double. All other tag types (A, Z, J, H, B) are stored as
+    /// strings in one pool with bounds. Lines that do not have the tag are marked absent, with a zero or empty value.
+    ///
+
+    /// Attributes ///
+    char line_type;
+    string tag;
+    char tag_type;
+    ArrayView <uint8_t> present;
+    ArrayView <int64_t> integers;
+    ArrayView <double> floats;
+    ArrayView <char> strings;
+    ArrayView <uint64_t> string_bounds;
+
+    /// Methods ///
+    size_t size() const;
+    bool has_value(size_t i) const;
+    int64_t get_integer(size_t i) const;
+    double get_float(size_t i) const;
+    string_view get_string(size_t i) const;
+    static bool is_numeric(char tag_type);
+};
+
+
+enum GFAIndexStatus {
+    INDEX_CURRENT,      // The GFA is unchanged since it was indexed
+    INDEX_APPENDED,     // The GFA only grew at the end, so the existing entries are still valid
+    INDEX_STALE,        // The GFA was modified or replaced, and must be reindexed
+};
+
+
+// Identifiers of the sections stored in a .gfai file
+enum GFAIndexSection: uint64_t {
+    LINE_TYPES = 1,
+    LINE_OFFSETS = 2,
+    TYPE_CODES = 3,
+    TYPE_LINE_BOUNDS = 4,
+    TYPE_LINES = 5,
+    SOURCE_STAMP = 6,
+    NODE_NAMES = 7,
+    NODE_NAME_BOUNDS = 8,
+    NODE_SEQUENCE_LINES = 9,
+    NODE_LINK_BOUNDS = 10,
+    NODE_LINK_LINES = 11,
+    NODE_ID_OFFSET = 12,
+    NODE_HANDLES_BY_ID = 13,
+    ADJACENCY_BOUNDS = 14,
+    ADJACENCY_EDGES = 15,
+    SEQUENCE_LENGTHS = 16,
+    BGZF_COMPRESSED_OFFSETS = 17,       // Only present if the GFA is BGZF compressed
+    BGZF_UNCOMPRESSED_OFFSETS = 18,
+    LINE_OFFSETS_COMPRESSED = 19,       // Only present if offsets are compressed, replacing LINE_OFFSETS
+    TYPE_LINES_COMPRESSED = 20,         // Only present if offsets are compressed, replacing TYPE_LINES
+    TYPE_LINES_COMPRESSED_BOUNDS = 21,
+    SEQUENCE_PACKED = 22,               // Only present once the sequence store has been requested
+    SEQUENCE_BOUNDS = 23,
+    SEQUENCE_EXCEPTION_POSITIONS = 24,
+    SEQUENCE_EXCEPTION_BASES = 25,
+    TAG_COLUMNS = uint64_t(1) << 32,    // Base of the tag column sections, which are only added when requested
+};
+
+
+// Parts of a tag column, each stored in its own section
+enum GFATagColumnPart: uint64_t {
+    TAG_PRESENT = 0,
+    TAG_VALUES = 1,
+    TAG_STRING_BOUNDS = 2,
+};
+
+
+uint64_t get_tag_column_section(char line_type, string_view tag, char tag_type, GFATagColumnPart part);
+
+
+#endif //SV_ALIGN_GFAINDEX_HPP
@@ -0,0 +1,57 @@
+#ifndef SV_ALIGN_GFAINDEXER_HPP
+#define SV_ALIGN_GFAINDEXER_HPP
+
+#include "GFAIndex.hpp"
+#include "MappedFile.hpp"
+#include <experimental/filesystem>
+#include <string_view>
+#include <vector>
+
+using std::experimental::filesystem::path;
+using std::string_view;
+using std::vector;
+
+class GFAReader;
+class GFANodeEntries;
+
+// Parsing helpers, shared with other code that reads GFA lines
+void split_gfa_line(string_view line, vector <string_view>& fields, size_t max_fields);
+bool parse_orientation(string_view field, uint32_t& reversed);
+
+
+class GFAIndexer {
+public:
+    ///
+    /// Builds or refreshes the .gfai of a GFA. This is the only code which writes an index, and it never modifies
+    /// the GFAReader that it is given, so the reader itself only ever has to map a finished index.
+    ///
+
+    /// Attributes ///
+    path gfa_path;
+    path gfa_index_path;
+    size_t n_threads;
+    bool compress_offsets;
+    static const char EOF_CODE;
+    static const uint64_t INDEX_MAGIC;
+    static const uint64_t INDEX_VERSION;
+    static const uint64_t INDEX_CHUNK_SIZE;
+    static const uint64_t INDEX_BGZF_BATCH_SIZE;
+
+    /// Methods ///
+    GFAIndexer(path gfa_path, path gfa_index_path, size_t n_threads, bool compress_offsets=false);
+    void index() const;
+    void index_bgzf(GFAIndexBuffers& buffers) const;
+    void extend_index(const GFAReader& previous) const;
+    GFAIndexStatus check_index_status(const GFAReader& reader) const;
+    void index_lines(const char* data, uint64_t size, uint64_t start, GFAIndexBuffers& buffers) const;
+    void index_line_range(const char* text, uint64_t text_start, uint64_t start, uint64_t stop, GFAIndexBuffers& buffers) const;
+    void index_nodes(const char* data, size_t first_line, const GFAReader* previous, GFAIndexBuffers& buffers) const;
+    void collect_node_entries(const char* text, uint64_t text_start, uint64_t text_stop, size_t first_line, const GFAIndexBuffers& buffers, GFANodeEntries& entries) const;
+    void build_node_table(GFANodeEntries& entries, GFAIndexBuffers& buffers) const;
+    void write_index_to_binary_file(const GFAIndexBuffers& buffers) const;
+    void add_sections_to_index(const GFAReader& reader) const;
+    uint64_t parse_sequence_length(const vector <string_view>& fields, uint64_t line_index) const;
+};
+
+
+#endif //SV_ALIGN_GFAINDEXER_HPP
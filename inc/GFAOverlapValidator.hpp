@@ -0,0 +1,73 @@
+#ifndef SV_ALIGN_GFAOVERLAPVALIDATOR_HPP
+#define SV_ALIGN_GFAOVERLAPVALIDATOR_HPP
+
+#include "GFAReader.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+using std::function;
+using std::string;
+using std::vector;
+using std::pair;
+
+
+class CigarStats{
+public:
+    /// Attributes ///
+    uint64_t n_matches = 0;
+    uint64_t n_mismatches = 0;
+    uint64_t n_inserts = 0;
+    uint64_t n_deletes = 0;
+
+    /// Methods ///
+    CigarStats& operator+=(const CigarStats& other);
+    string to_string() const;
+};
+
+
+class OverlapValidation{
+public:
+    ///
+    /// Result of checking one L line: the stats implied by its CIGAR, the stats found by actually comparing the
+    /// overlapping bases, and a description of anything that prevented the comparison
+    ///
+
+    /// Attributes ///
+    uint64_t line_index = 0;
+    string node_a;
+    string node_b;
+    uint32_t reversed_a = 0;
+    uint32_t reversed_b = 0;
+    vector <pair <char, uint64_t> > cigar;
+    CigarStats true_stats;
+    CigarStats gfa_stats;
+    string alignment;
+    string warning;
+
+    /// Methods ///
+    bool is_valid() const;
+    string get_link_string() const;
+};
+
+
+class GFAOverlapValidator{
+public:
+    ///
+    /// Check that the overlap CIGAR of every L line agrees with the sequences of its two segments. In orientation
+    /// '+' the overlap is the end of segment A and the start of segment B, and a '-' segment is reverse complemented
+    /// first. Links are split into chunks that are validated in parallel, all reading from one shared GFAReader.
+    ///
+
+    /// Attributes ///
+    const GFAReader& gfa_reader;
+    size_t n_threads;
+
+    /// Methods ///
+    GFAOverlapValidator(const GFAReader& gfa_reader, size_t n_threads);
+    void validate_link(uint64_t line_index, OverlapValidation& result) const;
+    void validate(const function<void(const OverlapValidation& result)>& on_invalid_link, CigarStats& total_true_stats, CigarStats& total_gfa_stats) const;
+};
+
+
+#endif //SV_ALIGN_GFAOVERLAPVALIDATOR_HPP
@@ -1,62 +1,168 @@
 #ifndef SV_ALIGN_GFAREADER_H
 #define SV_ALIGN_GFAREADER_H
 
+#include "ArrayView.hpp"
+#include "BGZFReader.hpp"
+#include "GFAIndex.hpp"
+#include "IndexFile.hpp"
+#include "PackedSequenceStore.hpp"
 #include <experimental/filesystem>
 #include <fstream>
+#include <memory>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <set>
 #include <unordered_set>
 #include <map>
 #include <unordered_map>
+#include <mutex>
 
 
 using std::experimental::filesystem::path;
 using std::ifstream;
 using std::ofstream;
 using std::string;
+using std::string_view;
 using std::vector;
 using std::pair;
 using std::set;
 using std::unordered_set;
 using std::map;
 using std::unordered_map;
+using std::unique_ptr;
+using std::function;
+using std::mutex;
 
-class GFAIndex{
+class GFAReadRange{
 public:
+    ///
+    /// One read of a contiguous byte range of the GFA, covering the sorted lines [first, stop) of a request
+    ///
+
     /// Attributes ///
-    char type;
-    uint64_t offset;
+    uint64_t start;
+    uint64_t stop;
+    size_t first;
+    size_t last;
+};
 
-    /// Methods ///
-    GFAIndex(char type, uint64_t offset);
+
+class GFALineBatch{
+public:
+    ///
+    /// Lines fetched together by GFAReader::read_lines(). All of them are stored in one arena, and lines[i] is the
+    /// i-th requested line, including its newline, so the views stay valid for as long as the batch does.
+    ///
+
+    /// Attributes ///
+    string arena;
+    vector <string_view> lines;
+    size_t n_reads;
 };
 
 
 class GFAReader {
 public:
+    ///
+    /// Query interface of an indexed GFA. The constructor builds, refreshes or loads the .gfai (see GFAIndexer), maps
+    /// it, and opens the GFA. After that the reader is immutable: every const method can be called concurrently from
+    /// any number of threads on one shared reader. Lines are read with pread on a descriptor that is opened once, so
+    /// threads never share a file position, and index columns are read in place from the mapping.
+    ///
+    /// A BGZF compressed GFA (bgzip) is read the same way: its line offsets refer to the uncompressed text, and reads
+    /// go through a BGZFReader, which decompresses only the blocks that are needed and caches recent ones.
+    ///
+    /// With compress_offsets, a newly built index stores its line offsets Elias-Fano encoded (see EliasFano), which is
+    /// much smaller for graphs with hundreds of millions of lines, at the cost of slower access to each offset. An
+    /// existing index is used in whichever form it was written.
+    ///
+    /// The exceptions are the legacy map_sequences_by_node() and map_links_by_node(), which fill the name keyed
+    /// maps below. They must be called, if at all, before the reader is shared between threads. Tag columns and the
+    /// sequence store are also loaded lazily, but under a lock, so their getters are safe to call from any thread.
+    ///
+
     /// Attributes ///
     path gfa_path;
     path gfa_index_path;
     int gfa_file_descriptor;
-    vector <GFAIndex> line_offsets;
-    map <char, vector <size_t> > line_indexes_by_type;
+    unique_ptr <MappedIndexFile> index_file;
+    unique_ptr <BGZFReader> bgzf_reader;
+    GFALineOffsets line_offsets;
+    map <char, MonotoneView> line_indexes_by_type;
+    GFANodeTable node_table;
+    ArrayView <uint64_t> adjacency_bounds;
+    ArrayView <GFAEdge> adjacency_edges;
+    ArrayView <uint64_t> sequence_lengths;
     unordered_map <string, size_t> sequence_line_indexes_by_node;
     unordered_map <string, set <size_t> > link_line_indexes_by_node;
-    static const char EOF_CODE;
+    mutable mutex lazy_section_mutex;
+    mutable map <uint64_t, ArrayView <char> > added_sections;     // Built by this reader, not yet saved to the index
+    mutable map <uint64_t, GFATagColumn> tag_columns;
+    mutable map <uint64_t, unique_ptr <GFATagColumnBuffers> > tag_column_buffers;
+    mutable unique_ptr <PackedSequenceStore> sequence_store;
+    mutable unique_ptr <PackedSequenceBuffers> sequence_buffers;
+    size_t n_threads;
+    static const uint64_t READ_COALESCE_GAP;
+    static const uint64_t READ_BLOCK_SIZE;
+    static const uint64_t NO_LIMIT;
 
     /// Methods ///
-    GFAReader(path gfa_path);
+    GFAReader(path gfa_path, size_t n_threads=1, bool compress_offsets=false);
+    GFAReader(const GFAReader& other) = delete;
+    GFAReader& operator=(const GFAReader& other) = delete;
     ~GFAReader();
-    void index();
     void read_index();
-    void write_index_to_binary_file();
     void map_sequences_by_node();
     void map_links_by_node();
-    void read_line(string& s, size_t index);
-    void write_link_subset_to_file(unordered_set<string>& node_subset, ofstream& output_file);
-    void write_subgraph_to_file(unordered_set <string>& nodes, ofstream& output_gfa);
-    uint64_t get_sequence_length(string node_name);
+    void read_bytes(string& s, uint64_t offset, uint64_t length) const;
+    void read_bytes(char* destination, uint64_t offset, uint64_t length) const;
+    void read_line(string& s, size_t index) const;
+    uint64_t get_line_virtual_offset(size_t index) const;
+    void plan_line_reads(const vector <uint64_t>& line_indexes, vector <GFAReadRange>& ranges) const;
+    void for_each_line(const vector <uint64_t>& line_indexes, const function<void(uint64_t line_index, string_view line)>& f) const;
+    void read_lines(const vector <uint64_t>& line_indexes, GFALineBatch& batch) const;
+    void write_link_subset_to_file(const unordered_set<string>& node_subset, ofstream& output_file) const;
+    void write_link_subset_to_file(const vector <NodeHandle>& node_subset, ofstream& output_file) const;
+    void write_subgraph_to_file(const unordered_set <string>& nodes, ofstream& output_gfa) const;
+    void write_subgraph_to_file(const vector <NodeHandle>& nodes, ofstream& output_gfa) const;
+    void write_subgraphs_to_files(const vector <vector <NodeHandle> >& node_sets, const vector <path>& output_paths) const;
+    uint64_t get_sequence_length(string node_name) const;
+    uint64_t get_sequence_length(NodeHandle handle) const;
+    void get_sequence_lengths(const vector <NodeHandle>& handles, vector <uint64_t>& lengths) const;
+
+    // Tags
+    void extract_tag_column(char line_type, string_view tag, char tag_type, GFATagColumnBuffers& buffers) const;
+    const GFATagColumn& get_tag_column(char line_type, string_view tag, char tag_type) const;
+
+    // Sequences
+    void build_sequence_store(PackedSequenceBuffers& buffers) const;
+    const PackedSequenceStore& get_sequence_store() const;
+
+    // Sections added to the index after it was built
+    template<class T> void add_section(uint64_t id, const vector<T>& v) const;
+    void save_added_sections() const;
+
+    // Node handles
+    size_t get_node_count() const;
+    bool find_node_handle(string_view node_name, NodeHandle& handle) const;
+    bool find_node_handle(int64_t node_id, NodeHandle& handle) const;
+    NodeHandle get_node_handle(string_view node_name) const;
+    NodeHandle get_node_handle(int64_t node_id) const;
+    string_view get_node_name(NodeHandle handle) const;
+    uint64_t get_sequence_line_index(NodeHandle handle) const;
+    ArrayView <uint64_t> get_link_line_indexes(NodeHandle handle) const;
+
+    // Adjacency
+    ArrayView <GFAEdge> get_edges(NodeHandle handle) const;
+    void for_each_neighbor(NodeHandle handle, bool reversed, const function<void(const GFAEdge& edge)>& f) const;
+    void get_neighborhood(const vector <NodeHandle>& seeds, uint64_t max_hops, uint64_t max_distance, vector <NodeHandle>& neighborhood) const;
 };
 
 
+template<class T> void GFAReader::add_section(uint64_t id, const vector<T>& v) const{
+    this->added_sections[id] = {reinterpret_cast<const char*>(v.data()), v.size()*sizeof(T)};
+}
+
+
 #endif //SV_ALIGN_GFAREADER_H
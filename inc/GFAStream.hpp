@@ -0,0 +1,46 @@
+#ifndef SV_ALIGN_GFASTREAM_HPP
+#define SV_ALIGN_GFASTREAM_HPP
+
+#include <experimental/filesystem>
+#include <functional>
+#include <string_view>
+#include <vector>
+#include <map>
+
+using std::experimental::filesystem::path;
+using std::function;
+using std::string_view;
+using std::vector;
+using std::map;
+
+// Called with the line (without its newline) and its tab separated fields, of which the first is the record type
+typedef function<void(string_view line, const vector <string_view>& fields)> GFARecordHandler;
+
+
+class GFAStream {
+public:
+    ///
+    /// Index-free alternative to GFAReader, for GFAs that are only read once, or cannot be indexed (read-only
+    /// directories, pipes, stdin). The GFA is parsed in a single forward pass, through one reusable buffer, and each
+    /// record is passed to the handler registered for its type. Records of types without a handler are skipped without
+    /// being split. Plain, gzip and BGZF input are all accepted, and a path of "-" reads from stdin.
+    ///
+    /// The views given to a handler are only valid until it returns.
+    ///
+
+    /// Attributes ///
+    path gfa_path;
+    size_t buffer_size;
+    map <char, GFARecordHandler> handlers;
+    GFARecordHandler default_handler;
+    static const size_t DEFAULT_BUFFER_SIZE;
+
+    /// Methods ///
+    GFAStream(path gfa_path, size_t buffer_size=DEFAULT_BUFFER_SIZE);
+    void set_handler(char type, const GFARecordHandler& handler);
+    void set_default_handler(const GFARecordHandler& handler);
+    uint64_t stream() const;
+};
+
+
+#endif //SV_ALIGN_GFASTREAM_HPP
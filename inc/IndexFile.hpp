@@ -0,0 +1,125 @@
+#ifndef SV_ALIGN_INDEXFILE_HPP
+#define SV_ALIGN_INDEXFILE_HPP
+
+#include "ArrayView.hpp"
+#include "BinaryIO.hpp"
+#include "MappedFile.hpp"
+#include <experimental/filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+
+using std::experimental::filesystem::path;
+using std::ofstream;
+using std::string;
+using std::vector;
+using std::map;
+
+
+///
+/// Sectioned binary container used for on-disk indexes. The layout is:
+///     header:     magic, format version, directory offset, number of sections (4 x uint64_t)
+///     sections:   raw arrays, each starting on an 8 byte boundary
+///     directory:  one (id, offset, size) triplet of uint64_t per section
+/// Because every section is aligned, a memory mapped file can be used in place as arrays of fixed width types.
+/// Sections can be appended to an existing file, followed by a new directory, which leaves the old directory behind
+/// as unused bytes.
+///
+
+
+class IndexSection{
+public:
+    /// Attributes ///
+    uint64_t id;
+    uint64_t offset;
+    uint64_t size;
+};
+
+
+class MappedIndexFile;
+
+
+class FileLock{
+public:
+    ///
+    /// Advisory lock (flock) on a file, held from construction until release() or destruction. The file is opened
+    /// with `open_flags`, and its descriptor can be used for I/O while the lock is held.
+    ///
+
+    /// Attributes ///
+    path file_path;
+    int file_descriptor;
+
+    /// Methods ///
+    FileLock(path file_path, int open_flags, bool exclusive);
+    FileLock(const FileLock& other) = delete;
+    FileLock& operator=(const FileLock& other) = delete;
+    ~FileLock();
+    void release();
+};
+
+
+class IndexFileWriter{
+public:
+    /// Attributes ///
+    path file_path;
+    path temp_path;
+    ofstream file;
+    BinaryWriter writer;
+    uint64_t magic;
+    uint64_t version;
+    uint64_t cursor;
+    vector <IndexSection> sections;
+    bool is_closed;
+
+    /// Methods ///
+    IndexFileWriter(path file_path, uint64_t magic, uint64_t version);
+    IndexFileWriter(const IndexFileWriter& other) = delete;
+    IndexFileWriter& operator=(const IndexFileWriter& other) = delete;
+    ~IndexFileWriter();
+    void write_section(uint64_t id, const char* data, uint64_t size);
+    template<class T> void write_section(uint64_t id, const vector<T>& v);
+    template<class T> void write_section(uint64_t id, const T& value);
+    void close();
+};
+
+
+template<class T> void IndexFileWriter::write_section(uint64_t id, const vector<T>& v){
+    this->write_section(id, reinterpret_cast<const char*>(v.data()), v.size()*sizeof(T));
+}
+
+
+template<class T> void IndexFileWriter::write_section(uint64_t id, const T& value){
+    this->write_section(id, reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+
+class MappedIndexFile{
+public:
+    /// Attributes ///
+    FileLock lock;                              // Only held while the header and directory are read
+    MappedFile file;
+    map <uint64_t, IndexSection> sections;
+
+    /// Methods ///
+    MappedIndexFile(path file_path, uint64_t magic, uint64_t version);
+    bool has_section(uint64_t id) const;
+    void append_sections(const map <uint64_t, ArrayView <char> >& new_sections) const;
+    template<class T> ArrayView<T> get_section(uint64_t id) const;
+};
+
+
+template<class T> ArrayView<T> MappedIndexFile::get_section(uint64_t id) const{
+    auto result = this->sections.find(id);
+
+    if (result == this->sections.end()){
+        throw runtime_error("ERROR: section " + std::to_string(id) + " not found in index: " + this->file.file_path.string());
+    }
+
+    auto& section = result->second;
+    return {reinterpret_cast<const T*>(this->file.data + section.offset), section.size/sizeof(T)};
+}
+
+
+#endif //SV_ALIGN_INDEXFILE_HPP
@@ -0,0 +1,29 @@
+#ifndef SV_ALIGN_MAPPEDFILE_HPP
+#define SV_ALIGN_MAPPEDFILE_HPP
+
+#include <experimental/filesystem>
+#include <string>
+#include <stdexcept>
+
+using std::experimental::filesystem::path;
+using std::string;
+using std::runtime_error;
+
+
+class MappedFile {
+public:
+    /// Attributes ///
+    path file_path;
+    int file_descriptor;
+    char* data;
+    uint64_t size;
+
+    /// Methods ///
+    MappedFile(path file_path);
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+    ~MappedFile();
+};
+
+
+#endif //SV_ALIGN_MAPPEDFILE_HPP
@@ -0,0 +1,64 @@
+#ifndef SV_ALIGN_PACKEDSEQUENCESTORE_HPP
+#define SV_ALIGN_PACKEDSEQUENCESTORE_HPP
+
+#include "ArrayView.hpp"
+#include "GFAIndex.hpp"
+#include <string_view>
+#include <string>
+#include <vector>
+
+using std::string_view;
+using std::string;
+using std::vector;
+
+
+class PackedSequenceBuffers{
+public:
+    ///
+    /// Owned storage for a sequence store that was just built, and which is not yet part of a mapped index
+    ///
+
+    /// Attributes ///
+    vector <uint64_t> packed;
+    vector <uint64_t> bounds;
+    vector <uint64_t> exception_positions;
+    vector <char> exception_bases;
+
+    /// Methods ///
+    void append(string_view sequence);
+    void append(const PackedSequenceBuffers& other);
+};
+
+
+class PackedSequenceStore{
+public:
+    ///
+    /// All segment sequences of a GFA, concatenated in NodeHandle order and packed 2 bits per base (A=0, C=1, G=2,
+    /// T=3), 32 bases per word. Any other character (N, IUPAC codes, lowercase) is an exception: its position and
+    /// original character are listed separately, and patched over the packed bases when a range is extracted, so
+    /// sequences come back exactly as written in the GFA. bounds[h] is the position of the first base of handle h.
+    ///
+
+    /// Attributes ///
+    ArrayView <uint64_t> packed;
+    ArrayView <uint64_t> bounds;
+    ArrayView <uint64_t> exception_positions;
+    ArrayView <char> exception_bases;
+
+    /// Methods ///
+    PackedSequenceStore();
+    PackedSequenceStore(const PackedSequenceBuffers& buffers);
+    size_t size() const;
+    uint64_t get_base_count() const;
+    uint64_t get_length(NodeHandle handle) const;
+    void get_sequence(NodeHandle handle, string& sequence) const;
+    void get_sequence(NodeHandle handle, uint64_t start, uint64_t length, bool reverse_complement, string& sequence) const;
+};
+
+
+char get_complement(char base);
+
+void reverse_complement_in_place(string& sequence);
+
+
+#endif //SV_ALIGN_PACKEDSEQUENCESTORE_HPP
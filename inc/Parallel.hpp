@@ -0,0 +1,13 @@
+#ifndef SV_ALIGN_PARALLEL_HPP
+#define SV_ALIGN_PARALLEL_HPP
+
+#include <functional>
+#include <cstddef>
+
+using std::function;
+
+
+void run_jobs_in_parallel(size_t n_jobs, size_t n_threads, const function<void(size_t job_index)>& job);
+
+
+#endif //SV_ALIGN_PARALLEL_HPP
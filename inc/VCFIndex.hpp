@@ -0,0 +1,100 @@
+#ifndef SV_ALIGN_VCFINDEX_HPP
+#define SV_ALIGN_VCFINDEX_HPP
+
+#include "ArrayView.hpp"
+#include "IndexFile.hpp"
+#include "MappedFile.hpp"
+#include <experimental/filesystem>
+#include <string_view>
+#include <string>
+#include <vector>
+#include <memory>
+
+using std::experimental::filesystem::path;
+using std::string_view;
+using std::unique_ptr;
+using std::string;
+using std::vector;
+
+
+// Identifiers of the sections stored in a .vcfi file
+enum VCFIndexSection: uint64_t {
+    VCF_SOURCE_STAMP = 1,
+    VCF_CHROMOSOME_NAMES = 2,
+    VCF_CHROMOSOME_NAME_BOUNDS = 3,
+    VCF_WINDOW_BOUNDS = 4,
+    VCF_WINDOW_OFFSETS = 5,
+    VCF_BGZF_COMPRESSED_OFFSETS = 6,        // Only present if the VCF is BGZF compressed
+    VCF_BGZF_UNCOMPRESSED_OFFSETS = 7,
+};
+
+
+class VCFSourceStamp{
+public:
+    ///
+    /// Identity of the VCF an index was built from, used to detect indexes that no longer describe their VCF
+    ///
+
+    /// Attributes ///
+    uint64_t file_size;
+    int64_t mtime_seconds;
+    int64_t mtime_nanoseconds;
+
+    /// Methods ///
+    bool operator==(const VCFSourceStamp& other) const;
+};
+
+
+VCFSourceStamp get_vcf_source_stamp(const MappedFile& vcf_file);
+
+
+class VCFIndexBuffers{
+public:
+    ///
+    /// Everything that is written to a .vcfi, accumulated in memory while the VCF is scanned in file order
+    ///
+
+    /// Attributes ///
+    VCFSourceStamp source_stamp;
+    vector <char> chromosome_names;
+    vector <uint64_t> chromosome_name_bounds = {0};
+    vector <uint64_t> window_bounds = {0};
+    vector <uint64_t> window_offsets;
+    vector <uint64_t> bgzf_compressed_offsets;
+    vector <uint64_t> bgzf_uncompressed_offsets;
+
+    /// Methods ///
+    void add_chromosome(string_view name);
+    void add_record(uint64_t offset, uint64_t start, uint64_t stop);
+    void write(path index_path) const;
+};
+
+
+class VCFIndex{
+public:
+    ///
+    /// Linear index of a position sorted VCF, equivalent to the linear part of a tabix index. Each chromosome is cut
+    /// into windows of 2^WINDOW_BITS bases, and every window stores the text offset of the first record which overlaps
+    /// it, or of the first record after it. All records overlapping a region are then found by reading forward from
+    /// the window of its start, until a record starts past its end. For a BGZF compressed VCF, offsets are positions
+    /// in the uncompressed text, and the stored block table converts them to file positions.
+    ///
+
+    /// Attributes ///
+    unique_ptr <MappedIndexFile> index_file;
+    ArrayView <char> chromosome_names;
+    ArrayView <uint64_t> chromosome_name_bounds;
+    ArrayView <uint64_t> window_bounds;
+    ArrayView <uint64_t> window_offsets;
+    static const uint64_t WINDOW_BITS;
+    static const uint64_t INDEX_MAGIC;
+    static const uint64_t INDEX_VERSION;
+
+    /// Methods ///
+    VCFIndex(path index_path);
+    VCFSourceStamp get_indexed_source_stamp() const;
+    bool find_offset(string_view chromosome, uint64_t start, uint64_t& offset) const;
+};
+
+
+#endif //SV_ALIGN_VCFINDEX_HPP
@@ -1,17 +1,24 @@
 #ifndef SV_ALIGN_VCFREADER_HPP
 #define SV_ALIGN_VCFREADER_HPP
 
+#include "BGZFReader.hpp"
+#include "MappedFile.hpp"
+#include "VCFIndex.hpp"
 #include <experimental/filesystem>
-#include <fstream>
+#include <functional>
+#include <string_view>
 #include <string>
 #include <vector>
 #include <utility>
+#include <memory>
 #include <map>
 
 using std::experimental::filesystem::path;
-using std::ifstream;
+using std::function;
+using std::string_view;
 using std::string;
 using std::vector;
+using std::unique_ptr;
 using std::pair;
 using std::map;
 
@@ -30,15 +37,99 @@ public:
     string to_string(char separator='\t');
 };
 
+class GenotypeMatrix{
+public:
+    ///
+    /// Genotypes of a set of samples, for a series of records. Columnar: each haplotype of each sample has its own
+    /// column of allele indexes, one byte per record, and each sample a column of flags. Samples are indexed in the
+    /// order they were selected, and sample_indexes maps a sample number (its column in the VCF, from 0) to that.
+    ///
+
+    /// Attributes ///
+    vector <uint16_t> sample_numbers;
+    vector <int32_t> sample_indexes;            // -1 for samples that are not selected
+    vector <vector <uint8_t> > alleles;         // 2 columns per sample
+    vector <vector <uint8_t> > flags;           // 1 column per sample
+    size_t n_records;
+    static const uint8_t PHASED;
+    static const uint8_t FIRST_MISSING;
+    static const uint8_t SECOND_MISSING;
+
+    /// Methods ///
+    GenotypeMatrix(const vector <uint16_t>& sample_numbers);
+    size_t get_sample_count() const;
+    void clear();
+    void add_record();
+    void append(const GenotypeMatrix& other, size_t record);
+    uint8_t get_allele(size_t record, size_t sample_index, bool haplotype) const;
+    bool is_phased(size_t record, size_t sample_index) const;
+};
+
+
+// Called with a record, and the matrix and row that hold its genotypes
+typedef function<void(const Variant& variant, const GenotypeMatrix& genotypes, size_t record)> GenotypeHandler;
+
+// Called with the chromosome that just ended (empty before the first record) and the one that starts (empty at EOF)
+typedef function<void(const string& previous_chromosome, const string& next_chromosome)> ChromosomeChangeHandler;
+
+
 class VCFReader {
 public:
+    ///
+    /// Records can be pulled one at a time with next(), in file order, into a Variant that the caller reuses, so
+    /// memory does not grow with the VCF. for_each() does the same in parallel, batch by batch, and read_all() collects
+    /// everything by chromosome.
+    ///
+    /// The file is memory mapped, and each line is split with memchr, which glibc vectorizes. Only the columns that
+    /// a Variant holds are materialized, and parsing stops at the selected sample. BGZF compressed VCFs are read
+    /// through their block table, and all offsets are positions in the uncompressed text.
+    ///
+    /// query() serves region queries from a .vcfi, written next to the VCF on first use.
+    ///
+
     /// Attributes ///
     path vcf_path;
+    path vcf_index_path;
+    MappedFile vcf_file;
+    unique_ptr <BGZFReader> bgzf_reader;
+    unique_ptr <VCFIndex> index;
+    uint64_t text_size;
+    uint64_t cursor;
+    vector <char> window;
+    string_view window_text;
+    uint64_t window_start;
+    string current_chromosome;
+    ChromosomeChangeHandler on_chromosome_change;
+    static const uint64_t BYTES_PER_CHUNK;
+    static const uint64_t BYTES_PER_QUERY_CHUNK;
 
     /// Methods ///
     VCFReader(path vcf_path);
-    void read_all(map <string, vector <Variant> >& variants, uint16_t sample_number=0);
-    void parse_genotype(ifstream& vcf_file, char& c, Variant& variant);
+    void set_chromosome_change_handler(const ChromosomeChangeHandler& f);
+    void rewind();
+    void read_text(uint64_t start, uint64_t stop, vector <char>& buffer, string_view& text) const;
+    uint64_t find_line_end(uint64_t offset) const;
+    static bool find_next_record(string_view text, uint64_t& cursor, string_view& line);
+    void update_chromosome(const string& chromosome);
+    bool next(Variant& variant, uint16_t sample_number=0);
+    void for_each_chunk(
+            const function<void(size_t slot, uint64_t offset, string_view text)>& parse,
+            const function<void(size_t slot)>& consume,
+            size_t n_threads);
+    void for_each(const GenotypeHandler& f, const vector <uint16_t>& sample_numbers, size_t n_threads=1);
+    void for_each(const function<void(const Variant& variant)>& f, uint16_t sample_number=0, size_t n_threads=1);
+    void read_all(map <string, vector <Variant> >& variants, uint16_t sample_number=0, size_t n_threads=1);
+    void read_genotypes(vector <Variant>& variants, GenotypeMatrix& genotypes, size_t n_threads=1);
+    void get_sample_names(vector <string>& names) const;
+    bool load_index();
+    void build_index(size_t n_threads);
+    void query(const string& chromosome, uint64_t start, uint64_t stop, const GenotypeHandler& f, const vector <uint16_t>& sample_numbers, size_t n_threads=1);
+    void query(const string& chromosome, uint64_t start, uint64_t stop, const function<void(const Variant& variant)>& f, uint16_t sample_number=0, size_t n_threads=1);
+    static const char* parse_fixed_columns(string_view line, Variant& variant);
+    static void parse_record(string_view line, Variant& variant, uint16_t sample_number);
+    static void parse_record(string_view line, Variant& variant, GenotypeMatrix& genotypes);
+    static void parse_genotype(string_view field, uint8_t& first, uint8_t& second, uint8_t& flags);
+    static void parse_genotype(string_view field, Variant& variant);
 };
 
 
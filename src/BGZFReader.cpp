@@ -0,0 +1,322 @@
+#include "BGZFReader.hpp"
+#include "BinaryIO.hpp"
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+using std::runtime_error;
+using std::lock_guard;
+using std::make_shared;
+
+
+// Fixed part of a BGZF block header: gzip magic, CM, FLG, MTIME, XFL, OS, XLEN
+const uint64_t BGZF_HEADER_SIZE = 12;
+
+// CRC32 and ISIZE
+const uint64_t BGZF_FOOTER_SIZE = 8;
+
+
+uint16_t read_uint16_le(const char* bytes){
+    return uint16_t(uint8_t(bytes[0])) | uint16_t(uint8_t(bytes[1])) << 8;
+}
+
+
+uint32_t read_uint32_le(const char* bytes){
+    return uint32_t(read_uint16_le(bytes)) | uint32_t(read_uint16_le(bytes + 2)) << 16;
+}
+
+
+void decompress_block(const char* compressed, uint64_t compressed_size, char* destination, uint64_t uncompressed_size){
+    ///
+    /// Inflate one complete BGZF block (header included, zlib parses it) into exactly `uncompressed_size` bytes
+    ///
+
+    z_stream stream = {};
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(compressed));
+    stream.avail_in = uInt(compressed_size);
+    stream.next_out = reinterpret_cast<Bytef*>(destination);
+    stream.avail_out = uInt(uncompressed_size);
+
+    // 15 bits of window, +16 to expect a gzip header rather than a zlib one
+    if (inflateInit2(&stream, 15 + 16) != Z_OK){
+        throw runtime_error("ERROR: could not initialize zlib");
+    }
+
+    auto result = inflate(&stream, Z_FINISH);
+    auto n_bytes = stream.total_out;
+    inflateEnd(&stream);
+
+    if (result != Z_STREAM_END or n_bytes != uncompressed_size){
+        throw runtime_error("ERROR: corrupt BGZF block, zlib status " + std::to_string(result));
+    }
+}
+
+
+BGZFReader::BGZFReader(path file_path, size_t max_cached_blocks){
+    this->file_path = file_path;
+    this->max_cached_blocks = std::max(size_t(1), max_cached_blocks);
+    this->cache_clock = 0;
+
+    this->file_descriptor = ::open(this->file_path.c_str(), O_RDONLY);
+
+    if (this->file_descriptor == -1){
+        throw runtime_error("ERROR: file could not be opened: " + this->file_path.string());
+    }
+}
+
+
+BGZFReader::~BGZFReader(){
+    ::close(this->file_descriptor);
+}
+
+
+bool BGZFReader::is_gzip(const char* data, uint64_t size){
+    return size >= 2 and uint8_t(data[0]) == 0x1f and uint8_t(data[1]) == 0x8b;
+}
+
+
+bool BGZFReader::is_bgzf(const char* data, uint64_t size){
+    ///
+    /// A BGZF block is a gzip member with the FEXTRA flag, whose first extra subfield is "BC" with 2 bytes of data
+    ///
+
+    if (size < BGZF_HEADER_SIZE + 6 or not is_gzip(data, size)){
+        return false;
+    }
+
+    return uint8_t(data[2]) == 8 and (uint8_t(data[3]) & 4) != 0 and data[12] == 'B' and data[13] == 'C' and read_uint16_le(data + 14) == 2;
+}
+
+
+void BGZFReader::index_blocks(){
+    ///
+    /// Build the block table by walking the block headers. Each header gives the compressed size of its block, and
+    /// each footer gives the uncompressed size, so nothing has to be decompressed.
+    ///
+
+    MappedFile file(this->file_path);
+    const char* data = file.data;
+
+    this->compressed_offsets.clear();
+    this->uncompressed_offsets.clear();
+
+    uint64_t compressed_offset = 0;
+    uint64_t uncompressed_offset = 0;
+
+    while (compressed_offset < file.size){
+        const char* block = data + compressed_offset;
+        uint64_t remaining = file.size - compressed_offset;
+
+        if (not is_gzip(block, remaining) or remaining < BGZF_HEADER_SIZE or (uint8_t(block[3]) & 4) == 0){
+            throw runtime_error("ERROR: invalid BGZF block at offset " + std::to_string(compressed_offset) + " in " + this->file_path.string());
+        }
+
+        // Search the extra subfields for BC, which holds the total block size minus 1
+        uint64_t extra_length = read_uint16_le(block + 10);
+        uint64_t block_size = 0;
+
+        for (uint64_t i=BGZF_HEADER_SIZE; i + 4 <= BGZF_HEADER_SIZE + extra_length and i + 4 <= remaining;){
+            uint64_t subfield_length = read_uint16_le(block + i + 2);
+
+            if (block[i] == 'B' and block[i+1] == 'C' and subfield_length == 2 and i + 6 <= remaining){
+                block_size = uint64_t(read_uint16_le(block + i + 4)) + 1;
+                break;
+            }
+
+            i += 4 + subfield_length;
+        }
+
+        if (block_size < BGZF_HEADER_SIZE + extra_length + BGZF_FOOTER_SIZE or block_size > remaining){
+            throw runtime_error("ERROR: invalid BGZF block size at offset " + std::to_string(compressed_offset) + " in " + this->file_path.string());
+        }
+
+        this->compressed_offsets.emplace_back(compressed_offset);
+        this->uncompressed_offsets.emplace_back(uncompressed_offset);
+
+        compressed_offset += block_size;
+        uncompressed_offset += read_uint32_le(block + block_size - 4);
+    }
+
+    this->compressed_offsets.emplace_back(compressed_offset);
+    this->uncompressed_offsets.emplace_back(uncompressed_offset);
+}
+
+
+void BGZFReader::load_blocks(ArrayView<uint64_t> compressed_offsets, ArrayView<uint64_t> uncompressed_offsets){
+    if (compressed_offsets.size() != uncompressed_offsets.size() or compressed_offsets.empty()){
+        throw runtime_error("ERROR: inconsistent BGZF block table for " + this->file_path.string());
+    }
+
+    this->compressed_offsets.assign(compressed_offsets.begin(), compressed_offsets.end());
+    this->uncompressed_offsets.assign(uncompressed_offsets.begin(), uncompressed_offsets.end());
+}
+
+
+size_t BGZFReader::get_block_count() const{
+    return this->compressed_offsets.size() - 1;
+}
+
+
+uint64_t BGZFReader::get_uncompressed_size() const{
+    return this->uncompressed_offsets.back();
+}
+
+
+size_t BGZFReader::find_block(uint64_t uncompressed_offset) const{
+    ///
+    /// Index of the block containing an uncompressed offset. Empty blocks (such as the EOF marker) are never returned
+    /// for an offset inside the stream, because the last block starting at or before the offset is chosen.
+    ///
+
+    if (uncompressed_offset >= this->get_uncompressed_size()){
+        throw runtime_error("ERROR: offset " + std::to_string(uncompressed_offset) + " is beyond the end of " + this->file_path.string());
+    }
+
+    auto end = this->uncompressed_offsets.end() - 1;
+    auto result = std::upper_bound(this->uncompressed_offsets.begin(), end, uncompressed_offset);
+
+    return size_t(result - this->uncompressed_offsets.begin()) - 1;
+}
+
+
+uint64_t BGZFReader::get_virtual_offset(uint64_t uncompressed_offset) const{
+    ///
+    /// Standard BGZF virtual offset: compressed offset of the block in the upper 48 bits, and the position within the
+    /// uncompressed block in the lower 16 bits, as returned by tell_group() for GAM files
+    ///
+
+    auto b = this->find_block(uncompressed_offset);
+    return (this->compressed_offsets[b] << 16) | (uncompressed_offset - this->uncompressed_offsets[b]);
+}
+
+
+uint64_t BGZFReader::get_uncompressed_offset(uint64_t virtual_offset) const{
+    uint64_t compressed_offset = virtual_offset >> 16;
+    auto end = this->compressed_offsets.end() - 1;
+    auto result = std::lower_bound(this->compressed_offsets.begin(), end, compressed_offset);
+
+    if (result == end or *result != compressed_offset){
+        throw runtime_error("ERROR: virtual offset does not point to a block start in " + this->file_path.string());
+    }
+
+    return this->uncompressed_offsets[result - this->compressed_offsets.begin()] + (virtual_offset & 0xFFFF);
+}
+
+
+void BGZFReader::decompress_all(vector<char>& data, size_t n_threads) const{
+    ///
+    /// Decompress the entire file into memory
+    ///
+
+    data.resize(this->get_uncompressed_size());
+    this->decompress_blocks(0, this->get_block_count(), data.data(), n_threads);
+}
+
+
+void BGZFReader::decompress_blocks(size_t first_block, size_t stop_block, char* destination, size_t n_threads) const{
+    ///
+    /// Decompress the blocks [first_block, stop_block) to `destination`, which must have room for all of them. Blocks
+    /// are independent, so they are inflated in parallel, each directly into its final position.
+    ///
+
+    MappedFile file(this->file_path);
+
+    if (file.size != this->compressed_offsets.back()){
+        throw runtime_error("ERROR: BGZF block table does not match file: " + this->file_path.string());
+    }
+
+    if (first_block > stop_block or stop_block > this->get_block_count()){
+        throw runtime_error("ERROR: block range out of bounds in " + this->file_path.string());
+    }
+
+    auto start = this->uncompressed_offsets[first_block];
+
+    run_jobs_in_parallel(stop_block - first_block, n_threads, [&](size_t i){
+        auto b = first_block + i;
+        auto compressed_size = this->compressed_offsets[b+1] - this->compressed_offsets[b];
+        auto uncompressed_size = this->uncompressed_offsets[b+1] - this->uncompressed_offsets[b];
+
+        decompress_block(file.data + this->compressed_offsets[b], compressed_size, destination + this->uncompressed_offsets[b] - start, uncompressed_size);
+    });
+}
+
+
+shared_ptr<const string> BGZFReader::get_block(size_t block_index) const{
+    ///
+    /// Fetch one decompressed block through the cache. Decompression happens outside the lock, so threads only wait
+    /// on each other for the lookup. When the cache is full, the least recently used block is evicted. Blocks stay
+    /// valid for as long as a caller holds them, even after eviction.
+    ///
+
+    {
+        lock_guard<mutex> lock(this->cache_mutex);
+        auto result = this->cached_blocks.find(block_index);
+
+        if (result != this->cached_blocks.end()){
+            result->second.second = ++this->cache_clock;
+            return result->second.first;
+        }
+    }
+
+    auto compressed_size = this->compressed_offsets.at(block_index + 1) - this->compressed_offsets[block_index];
+    auto uncompressed_size = this->uncompressed_offsets[block_index + 1] - this->uncompressed_offsets[block_index];
+
+    string compressed;
+    off_t offset = this->compressed_offsets[block_index];
+    pread_string_from_binary(this->file_descriptor, compressed, compressed_size, offset);
+
+    auto block = make_shared<string>(uncompressed_size, '\0');
+    decompress_block(compressed.data(), compressed_size, block->data(), uncompressed_size);
+
+    lock_guard<mutex> lock(this->cache_mutex);
+
+    if (this->cached_blocks.size() >= this->max_cached_blocks and this->cached_blocks.count(block_index) == 0){
+        auto oldest = std::min_element(this->cached_blocks.begin(), this->cached_blocks.end(), [](auto& a, auto& b){
+            return a.second.second < b.second.second;
+        });
+        this->cached_blocks.erase(oldest);
+    }
+
+    this->cached_blocks[block_index] = {block, ++this->cache_clock};
+
+    return block;
+}
+
+
+void BGZFReader::read(uint64_t offset, uint64_t length, string& s) const{
+    s.resize(length);
+    this->read(offset, length, s.data());
+}
+
+
+void BGZFReader::read(uint64_t offset, uint64_t length, char* destination) const{
+    ///
+    /// Copy `length` uncompressed bytes starting at `offset`, which may span any number of blocks
+    ///
+
+    if (length == 0){
+        return;
+    }
+
+    if (offset + length > this->get_uncompressed_size()){
+        throw runtime_error("ERROR: read beyond the end of " + this->file_path.string());
+    }
+
+    uint64_t n_copied = 0;
+    auto b = this->find_block(offset);
+
+    while (n_copied < length){
+        auto block = this->get_block(b);
+        uint64_t block_offset = offset + n_copied - this->uncompressed_offsets[b];
+        uint64_t n_bytes = std::min(length - n_copied, uint64_t(block->size()) - block_offset);
+
+        memcpy(destination + n_copied, block->data() + block_offset, n_bytes);
+        n_copied += n_bytes;
+        b++;
+    }
+}
@@ -54,4 +54,225 @@ void pread_string_from_binary(int file_descriptor, string& s, uint64_t length, o
     pread_bytes(file_descriptor, buffer_pointer, bytes_to_read, offset);
 }
 
+
+const size_t BinaryWriter::DEFAULT_BUFFER_SIZE = 1024*1024;
+const size_t BinaryReader::DEFAULT_BUFFER_SIZE = 1024*1024;
+
+
+uint64_t encode_zigzag(int64_t v){
+    ///
+    /// Interleave signed values as 0, -1, 1, -2, 2 ... so that their varints are short for small magnitudes
+    ///
+
+    return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+
+int64_t decode_zigzag(uint64_t v){
+    return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+
+BinaryWriter::BinaryWriter(ostream& stream, size_t buffer_size):
+    stream(stream),
+    buffer_size(std::max(size_t(16), buffer_size)),
+    n_flushed(0)
+{
+    this->buffer.reserve(this->buffer_size);
+}
+
+
+BinaryWriter::~BinaryWriter(){
+    this->flush();
+}
+
+
+void BinaryWriter::write_bytes(const char* data, size_t size){
+    // Large writes skip the buffer entirely, once whatever precedes them has been flushed
+    if (size >= this->buffer_size){
+        this->flush();
+        this->stream.write(data, size);
+        this->n_flushed += size;
+        return;
+    }
+
+    if (this->buffer.size() + size > this->buffer_size){
+        this->flush();
+    }
+
+    this->buffer.insert(this->buffer.end(), data, data + size);
+}
+
+
+void BinaryWriter::write_varint(uint64_t v){
+    char bytes[10];
+    size_t n = 0;
+
+    while (v >= 0x80){
+        bytes[n++] = char((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    bytes[n++] = char(v);
+
+    this->write_bytes(bytes, n);
+}
+
+
+void BinaryWriter::write_zigzag(int64_t v){
+    this->write_varint(encode_zigzag(v));
+}
+
+
+void BinaryWriter::write_string(string_view s){
+    this->write_varint(s.size());
+    this->write_bytes(s.data(), s.size());
+}
+
+
+uint64_t BinaryWriter::tell() const{
+    return this->n_flushed + this->buffer.size();
+}
+
+
+void BinaryWriter::flush(){
+    if (not this->buffer.empty()){
+        this->stream.write(this->buffer.data(), this->buffer.size());
+        this->n_flushed += this->buffer.size();
+        this->buffer.clear();
+    }
+
+    this->stream.flush();
+}
+
+
+BinaryReader::BinaryReader(istream& stream, size_t buffer_size):
+    stream(&stream),
+    file_descriptor(-1),
+    file_offset(0),
+    buffer(std::max(size_t(16), buffer_size)),
+    chunk(nullptr),
+    cursor(nullptr),
+    end(nullptr),
+    chunk_offset(0)
+{}
+
+
+BinaryReader::BinaryReader(int file_descriptor, off_t offset, size_t buffer_size):
+    stream(nullptr),
+    file_descriptor(file_descriptor),
+    file_offset(offset),
+    buffer(std::max(size_t(16), buffer_size)),
+    chunk(nullptr),
+    cursor(nullptr),
+    end(nullptr),
+    chunk_offset(0)
+{}
+
+
+BinaryReader::BinaryReader(const char* data, size_t size):
+    stream(nullptr),
+    file_descriptor(-1),
+    file_offset(0),
+    chunk(data),
+    cursor(data),
+    end(data + size),
+    chunk_offset(0)
+{}
+
+
+bool BinaryReader::refill(){
+    ///
+    /// Replace the (fully consumed) buffer with the next chunk of the source. Returns false at the end of the source.
+    ///
+
+    size_t n_bytes = 0;
+
+    if (this->stream != nullptr){
+        this->stream->read(this->buffer.data(), this->buffer.size());
+        n_bytes = size_t(this->stream->gcount());
+    }
+    else if (this->file_descriptor != -1){
+        auto result = ::pread(this->file_descriptor, this->buffer.data(), this->buffer.size(), this->file_offset);
+
+        if (result < 0){
+            throw runtime_error("ERROR " + std::to_string(errno) + " while reading: " + string(::strerror(errno)));
+        }
+
+        n_bytes = size_t(result);
+        this->file_offset += result;
+    }
+
+    // A memory span has no more data after its end
+    if (n_bytes == 0){
+        return false;
+    }
+
+    this->chunk_offset += uint64_t(this->end - this->chunk);
+    this->chunk = this->buffer.data();
+    this->cursor = this->chunk;
+    this->end = this->chunk + n_bytes;
+
+    return true;
+}
+
+
+bool BinaryReader::at_end(){
+    return this->cursor == this->end and not this->refill();
+}
+
+
+void BinaryReader::read_bytes(char* data, size_t size){
+    while (size > 0){
+        if (this->cursor == this->end and not this->refill()){
+            throw runtime_error("ERROR: unexpected end of binary data at byte " + std::to_string(this->tell()));
+        }
+
+        size_t n = std::min(size, size_t(this->end - this->cursor));
+        memcpy(data, this->cursor, n);
+
+        this->cursor += n;
+        data += n;
+        size -= n;
+    }
+}
+
+
+void BinaryReader::read_varint(uint64_t& v){
+    v = 0;
+
+    for (size_t shift=0; shift<64; shift+=7){
+        uint8_t byte;
+        this->read_bytes(reinterpret_cast<char*>(&byte), 1);
+
+        v |= uint64_t(byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0){
+            return;
+        }
+    }
+
+    throw runtime_error("ERROR: varint longer than 64 bits at byte " + std::to_string(this->tell()));
+}
+
+
+void BinaryReader::read_zigzag(int64_t& v){
+    uint64_t encoded;
+    this->read_varint(encoded);
+    v = decode_zigzag(encoded);
+}
+
+
+void BinaryReader::read_string(string& s){
+    uint64_t length;
+    this->read_varint(length);
+
+    s.resize(length);
+    this->read_bytes(s.data(), length);
+}
+
+
+uint64_t BinaryReader::tell() const{
+    return this->chunk_offset + uint64_t(this->cursor - this->chunk);
+}
+
 #endif //RUNLENGTH_ANALYSIS_BINARYIO_CPP_H
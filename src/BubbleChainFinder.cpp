@@ -0,0 +1,356 @@
+#include "BubbleChainFinder.hpp"
+#include "Parallel.hpp"
+#include <iostream>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <numeric>
+
+using std::unordered_map;
+using std::unordered_set;
+using std::cerr;
+
+
+const size_t BubbleChainFinder::DEFAULT_MAX_BUBBLE_SIZE = 1000;
+
+
+OrientedNode flip(OrientedNode v){
+    return v ^ 1;
+}
+
+
+NodeHandle get_handle(OrientedNode v){
+    return NodeHandle(v >> 1);
+}
+
+
+BubbleChainFinder::BubbleChainFinder(const GFAReader& gfa_reader, size_t n_threads, size_t max_bubble_size):
+    gfa_reader(gfa_reader),
+    n_threads(std::max(size_t(1), n_threads)),
+    max_bubble_size(max_bubble_size)
+{}
+
+
+void BubbleChainFinder::get_children(OrientedNode v, vector <OrientedNode>& children) const{
+    children.clear();
+
+    this->gfa_reader.for_each_neighbor(get_handle(v), v & 1, [&](const GFAEdge& edge){
+        children.emplace_back(OrientedNode(edge.neighbor)*2 + edge.neighbor_reversed);
+    });
+}
+
+
+void BubbleChainFinder::get_parents(OrientedNode v, vector <OrientedNode>& parents) const{
+    ///
+    /// Every link u -> v is also stored as v' -> u', so the parents of v are the flipped children of v'
+    ///
+
+    this->get_children(flip(v), parents);
+
+    for (auto& p: parents){
+        p = flip(p);
+    }
+}
+
+
+bool BubbleChainFinder::find_superbubble(OrientedNode entrance, Superbubble& superbubble, bool& is_abandoned) const{
+    ///
+    /// Search forward from a candidate entrance (Onodera et al. 2013). A node is only expanded once all of its
+    /// parents have been, so when exactly one node is left to expand and it is also the only node seen but not
+    /// expanded, it is the exit. The search gives up on tips, on cycles through the entrance, and once more than
+    /// max_bubble_size nodes have been expanded, which bounds the cost of each entrance. Only the last case sets
+    /// `is_abandoned`, since a bubble may still start at the entrance.
+    ///
+
+    is_abandoned = false;
+
+    vector <OrientedNode> stack = {entrance};
+    unordered_set <OrientedNode> visited;
+    unordered_set <OrientedNode> seen = {entrance};
+    unordered_set <OrientedNode> pushed = {entrance};
+    vector <OrientedNode> children;
+    vector <OrientedNode> parents;
+
+    while (not stack.empty()){
+        auto v = stack.back();
+        stack.pop_back();
+
+        visited.insert(v);
+        seen.erase(v);
+
+        if (this->max_bubble_size > 0 and visited.size() > this->max_bubble_size){
+            is_abandoned = true;
+            return false;
+        }
+
+        this->get_children(v, children);
+
+        if (children.empty()){
+            return false;
+        }
+
+        for (auto& u: children){
+            if (u == entrance){
+                return false;
+            }
+
+            seen.insert(u);
+            this->get_parents(u, parents);
+
+            bool all_parents_visited = std::all_of(parents.begin(), parents.end(), [&](OrientedNode p){
+                return visited.count(p) > 0;
+            });
+
+            if (all_parents_visited and pushed.insert(u).second){
+                stack.emplace_back(u);
+            }
+        }
+
+        if (stack.size() == 1 and seen.size() == 1 and seen.count(stack.back()) > 0){
+            auto exit = stack.back();
+
+            this->get_children(exit, children);
+
+            if (std::find(children.begin(), children.end(), entrance) != children.end()){
+                return false;
+            }
+
+            superbubble.entrance = entrance;
+            superbubble.exit = exit;
+            superbubble.interior.clear();
+
+            for (auto& w: visited){
+                if (w != entrance){
+                    superbubble.interior.emplace_back(get_handle(w));
+                }
+            }
+
+            std::sort(superbubble.interior.begin(), superbubble.interior.end());
+            superbubble.interior.erase(std::unique(superbubble.interior.begin(), superbubble.interior.end()), superbubble.interior.end());
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void BubbleChainFinder::find_connected_components(vector <uint32_t>& component_of_node, size_t& n_components) const{
+    ///
+    /// Label the weakly connected components with union-find, numbered in order of their smallest handle
+    ///
+
+    auto n_nodes = this->gfa_reader.get_node_count();
+    vector <NodeHandle> parent(n_nodes);
+    std::iota(parent.begin(), parent.end(), 0);
+
+    auto find_root = [&](NodeHandle x){
+        while (parent[x] != x){
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    };
+
+    for (NodeHandle h=0; h<n_nodes; h++){
+        for (auto& edge: this->gfa_reader.get_edges(h)){
+            auto a = find_root(h);
+            auto b = find_root(edge.neighbor);
+
+            if (a != b){
+                parent[std::max(a,b)] = std::min(a,b);
+            }
+        }
+    }
+
+    // Every root is the smallest handle of its component, so one ascending pass assigns consecutive labels
+    component_of_node.assign(n_nodes, 0);
+    n_components = 0;
+
+    for (NodeHandle h=0; h<n_nodes; h++){
+        auto root = find_root(h);
+
+        if (root == h){
+            component_of_node[h] = uint32_t(n_components++);
+        }
+        else{
+            component_of_node[h] = component_of_node[root];
+        }
+    }
+}
+
+
+void BubbleChainFinder::link_superbubbles(vector <Superbubble>& superbubbles, vector <vector <BubbleChainComponent> >& chains) const{
+    ///
+    /// Join superbubbles into chains, following the exit of each to the bubble which has it as entrance. Every
+    /// superbubble is also found in the opposite direction (exit' -> entrance'), so once a chain is emitted, the
+    /// mirrors of its bubbles are marked as used, and each chain is reported on one strand only. Chains that close
+    /// on themselves are emitted last, and marked circular. Bubbles nested inside another bubble are already part of
+    /// its interior component, so only the outermost ones are chained.
+    ///
+
+    unordered_set <NodeHandle> interior_nodes;
+    for (auto& superbubble: superbubbles){
+        interior_nodes.insert(superbubble.interior.begin(), superbubble.interior.end());
+    }
+
+    superbubbles.erase(std::remove_if(superbubbles.begin(), superbubbles.end(), [&](const Superbubble& superbubble){
+        return interior_nodes.count(get_handle(superbubble.entrance)) > 0;
+    }), superbubbles.end());
+
+    std::sort(superbubbles.begin(), superbubbles.end(), [](const Superbubble& a, const Superbubble& b){
+        return a.entrance < b.entrance;
+    });
+
+    unordered_map <OrientedNode, size_t> bubble_by_entrance;
+    unordered_map <OrientedNode, size_t> bubble_by_exit;
+
+    for (size_t i=0; i<superbubbles.size(); i++){
+        bubble_by_entrance[superbubbles[i].entrance] = i;
+        bubble_by_exit[superbubbles[i].exit] = i;
+    }
+
+    vector <bool> is_used(superbubbles.size(), false);
+
+    auto mark_used = [&](size_t i){
+        is_used[i] = true;
+
+        auto mirror = bubble_by_entrance.find(flip(superbubbles[i].exit));
+        if (mirror != bubble_by_entrance.end() and superbubbles[mirror->second].exit == flip(superbubbles[i].entrance)){
+            is_used[mirror->second] = true;
+        }
+    };
+
+    auto add_component = [&](vector <BubbleChainComponent>& chain, const vector <NodeHandle>& handles){
+        BubbleChainComponent component;
+        component.position = chain.size();
+
+        for (auto& handle: handles){
+            component.segments.emplace_back(this->gfa_reader.get_node_name(handle));
+        }
+
+        chain.emplace_back(component);
+    };
+
+    auto emit_chain = [&](size_t start, bool circular){
+        vector <BubbleChainComponent> chain;
+        add_component(chain, {get_handle(superbubbles[start].entrance)});
+
+        size_t i = start;
+        while (true){
+            mark_used(i);
+
+            // A bubble with an empty interior is a plain link, which only continues the chain
+            if (not superbubbles[i].interior.empty()){
+                add_component(chain, superbubbles[i].interior);
+            }
+
+            auto next = bubble_by_entrance.find(superbubbles[i].exit);
+
+            if (circular and next != bubble_by_entrance.end() and next->second == start){
+                break;
+            }
+
+            add_component(chain, {get_handle(superbubbles[i].exit)});
+
+            if (next == bubble_by_entrance.end() or is_used[next->second]){
+                break;
+            }
+
+            i = next->second;
+        }
+
+        for (auto& component: chain){
+            component.circular = circular;
+        }
+
+        chains.emplace_back(chain);
+    };
+
+    // Linear chains start at a bubble that no other bubble leads into
+    for (size_t i=0; i<superbubbles.size(); i++){
+        if (not is_used[i] and bubble_by_exit.count(superbubbles[i].entrance) == 0){
+            emit_chain(i, false);
+        }
+    }
+
+    // Anything left belongs to a cycle of bubbles
+    for (size_t i=0; i<superbubbles.size(); i++){
+        if (not is_used[i]){
+            emit_chain(i, true);
+        }
+    }
+}
+
+
+void BubbleChainFinder::find_bubble_chains(vector <vector <BubbleChainComponent> >& chains) const{
+    size_t n_abandoned_entrances;
+    this->find_bubble_chains(chains, n_abandoned_entrances);
+
+    if (n_abandoned_entrances > 0){
+        cerr << "WARNING: search abandoned at " << n_abandoned_entrances << " candidate entrances after "
+             << this->max_bubble_size << " nodes, bubbles larger than this are not reported\n";
+    }
+}
+
+
+void BubbleChainFinder::find_bubble_chains(vector <vector <BubbleChainComponent> >& chains, size_t& n_abandoned_entrances) const{
+    ///
+    /// Search every oriented node as a candidate entrance, in parallel chunks, then link the superbubbles of each
+    /// connected component into chains, one component per job. Chains are numbered in order of their component.
+    /// Entrances whose search exceeded max_bubble_size are counted, so that callers can report the bubbles that may
+    /// be missing.
+    ///
+
+    const size_t nodes_per_job = 4096;
+
+    auto n_nodes = this->gfa_reader.get_node_count();
+    size_t n_jobs = (n_nodes + nodes_per_job - 1) / nodes_per_job;
+    vector <vector <Superbubble> > superbubbles_per_job(n_jobs);
+    vector <size_t> n_abandoned_per_job(n_jobs, 0);
+
+    run_jobs_in_parallel(n_jobs, this->n_threads, [&](size_t j){
+        Superbubble superbubble;
+        bool is_abandoned;
+        size_t stop = std::min(n_nodes, (j+1)*nodes_per_job);
+
+        for (size_t h=j*nodes_per_job; h<stop; h++){
+            for (OrientedNode v=OrientedNode(h)*2; v<OrientedNode(h)*2 + 2; v++){
+                if (this->find_superbubble(v, superbubble, is_abandoned)){
+                    superbubbles_per_job[j].emplace_back(superbubble);
+                }
+                n_abandoned_per_job[j] += is_abandoned;
+            }
+        }
+    });
+
+    n_abandoned_entrances = std::accumulate(n_abandoned_per_job.begin(), n_abandoned_per_job.end(), size_t(0));
+
+    vector <uint32_t> component_of_node;
+    size_t n_components;
+    this->find_connected_components(component_of_node, n_components);
+
+    vector <vector <Superbubble> > superbubbles_per_component(n_components);
+    for (auto& superbubbles: superbubbles_per_job){
+        for (auto& superbubble: superbubbles){
+            superbubbles_per_component[component_of_node[get_handle(superbubble.entrance)]].emplace_back(std::move(superbubble));
+        }
+    }
+
+    vector <vector <vector <BubbleChainComponent> > > chains_per_component(n_components);
+
+    run_jobs_in_parallel(n_components, this->n_threads, [&](size_t c){
+        this->link_superbubbles(superbubbles_per_component[c], chains_per_component[c]);
+    });
+
+    chains.clear();
+    for (auto& component_chains: chains_per_component){
+        for (auto& chain: component_chains){
+            for (auto& component: chain){
+                component.id = chains.size();
+            }
+            chains.emplace_back(std::move(chain));
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#include "EliasFano.hpp"
+#include <string>
+
+
+const uint64_t EliasFano::SAMPLE_RATE = 64;
+
+// Number of words before the arrays in the encoded form
+const uint64_t ELIAS_FANO_HEADER_SIZE = 5;
+
+
+EliasFano::EliasFano(){
+    this->n = 0;
+    this->low_bits = 0;
+}
+
+
+void EliasFano::encode(const uint64_t* values, size_t n, vector <uint64_t>& words){
+    uint64_t universe = (n == 0) ? 0 : values[n-1] + 1;
+
+    // The low bits absorb the average gap, which leaves about 2 bits per value in the high part
+    uint64_t low_bits = 0;
+    while (n > 0 and (universe >> (low_bits + 1)) >= n){
+        low_bits++;
+    }
+
+    uint64_t n_low_words = (n*low_bits + 63)/64;
+    uint64_t n_high_bits = n + (universe >> low_bits) + 1;
+    uint64_t n_high_words = (n_high_bits + 63)/64;
+    uint64_t n_samples = (n + SAMPLE_RATE - 1)/SAMPLE_RATE;
+
+    words.assign(ELIAS_FANO_HEADER_SIZE + n_low_words + n_high_words + n_samples, 0);
+    words[0] = n;
+    words[1] = low_bits;
+    words[2] = n_low_words;
+    words[3] = n_high_words;
+    words[4] = n_samples;
+
+    uint64_t* low = words.data() + ELIAS_FANO_HEADER_SIZE;
+    uint64_t* high = low + n_low_words;
+    uint64_t* samples = high + n_high_words;
+    uint64_t low_mask = (low_bits == 64) ? ~uint64_t(0) : (uint64_t(1) << low_bits) - 1;
+
+    for (size_t i=0; i<n; i++){
+        if (i > 0 and values[i] < values[i-1]){
+            throw runtime_error("ERROR: Elias-Fano input is not sorted at index " + std::to_string(i));
+        }
+
+        if (low_bits > 0){
+            uint64_t bit = i*low_bits;
+            uint64_t value = values[i] & low_mask;
+
+            low[bit/64] |= value << (bit % 64);
+            if (bit % 64 + low_bits > 64){
+                low[bit/64 + 1] |= value >> (64 - bit % 64);
+            }
+        }
+
+        uint64_t position = (values[i] >> low_bits) + i;
+        high[position/64] |= uint64_t(1) << (position % 64);
+
+        if (i % SAMPLE_RATE == 0){
+            samples[i/SAMPLE_RATE] = position;
+        }
+    }
+}
+
+
+void EliasFano::load(ArrayView <uint64_t> words){
+    if (words.size() < ELIAS_FANO_HEADER_SIZE or words.size() != ELIAS_FANO_HEADER_SIZE + words[2] + words[3] + words[4]){
+        throw runtime_error("ERROR: Elias-Fano encoding is corrupt");
+    }
+
+    this->n = words[0];
+    this->low_bits = words[1];
+    this->low = {words.data() + ELIAS_FANO_HEADER_SIZE, words[2]};
+    this->high = {this->low.end(), words[3]};
+    this->samples = {this->high.end(), words[4]};
+}
+
+
+uint64_t EliasFano::operator[](size_t i) const{
+    ///
+    /// The i-th set bit of the high bitvector is at (high part of value i) + i. Scan forward from the sampled
+    /// position of the last multiple of SAMPLE_RATE, a word at a time with popcount, then bit by bit in the last word.
+    ///
+
+    uint64_t position = this->samples[i/SAMPLE_RATE];
+    uint64_t remaining = i % SAMPLE_RATE;
+
+    if (remaining > 0){
+        // Ones after the sampled one, within its word
+        uint64_t w = position/64;
+        uint64_t word = this->high[w] & (~uint64_t(0) << (position % 64)) & ~(uint64_t(1) << (position % 64));
+        uint64_t count = uint64_t(__builtin_popcountll(word));
+
+        while (count < remaining){
+            remaining -= count;
+            word = this->high[++w];
+            count = uint64_t(__builtin_popcountll(word));
+        }
+
+        for (uint64_t k=1; k<remaining; k++){
+            word &= word - 1;
+        }
+
+        position = w*64 + uint64_t(__builtin_ctzll(word));
+    }
+
+    uint64_t value = (position - i) << this->low_bits;
+
+    if (this->low_bits > 0){
+        uint64_t bit = i*this->low_bits;
+        uint64_t low_value = this->low[bit/64] >> (bit % 64);
+
+        if (bit % 64 + this->low_bits > 64){
+            low_value |= this->low[bit/64 + 1] << (64 - bit % 64);
+        }
+
+        value |= low_value & ((this->low_bits == 64) ? ~uint64_t(0) : (uint64_t(1) << this->low_bits) - 1);
+    }
+
+    return value;
+}
+
+
+size_t EliasFano::size() const{
+    return this->n;
+}
+
+
+MonotoneView::MonotoneView():
+    is_compressed(false)
+{}
+
+
+MonotoneView::MonotoneView(ArrayView <uint64_t> plain):
+    plain(plain),
+    is_compressed(false)
+{}
+
+
+MonotoneView::MonotoneView(const EliasFano& compressed):
+    compressed(compressed),
+    is_compressed(true)
+{}
+
+
+uint64_t MonotoneView::at(size_t i) const{
+    if (i >= this->size()){
+        throw runtime_error("ERROR: index " + std::to_string(i) + " out of range for view of size " + std::to_string(this->size()));
+    }
+
+    return (*this)[i];
+}
+
+
+uint64_t MonotoneView::back() const{
+    return (*this)[this->size() - 1];
+}
+
+
+size_t MonotoneView::size() const{
+    return this->is_compressed ? this->compressed.size() : this->plain.size();
+}
+
+
+bool MonotoneView::empty() const{
+    return this->size() == 0;
+}
@@ -0,0 +1,159 @@
+#include "GFAIndex.hpp"
+#include <limits>
+#include <charconv>
+
+
+const uint64_t GFANodeTable::NO_LINE = std::numeric_limits<uint64_t>::max();
+const NodeHandle GFANodeTable::NO_HANDLE = std::numeric_limits<NodeHandle>::max();
+
+
+GFAIndex::GFAIndex(char type, uint64_t offset){
+    this->type = type;
+    this->offset = offset;
+}
+
+
+GFAIndex GFALineOffsets::operator[](size_t i) const{
+    return {this->types[i], this->offsets[i]};
+}
+
+
+GFAIndex GFALineOffsets::back() const{
+    return (*this)[this->size() - 1];
+}
+
+
+size_t GFALineOffsets::size() const{
+    return this->offsets.size();
+}
+
+
+size_t GFANodeTable::size() const{
+    return this->sequence_lines.size();
+}
+
+
+string_view GFANodeTable::get_name(NodeHandle handle) const{
+    auto start = this->name_bounds[handle];
+    auto stop = this->name_bounds[handle+1];
+    return {this->names.data() + start, stop - start};
+}
+
+
+bool GFANodeTable::find(string_view name, NodeHandle& handle) const{
+    ///
+    /// Binary search for a node name, storing its handle if found
+    ///
+
+    size_t low = 0;
+    size_t high = this->size();
+
+    while (low < high){
+        size_t middle = low + (high - low)/2;
+
+        if (this->get_name(middle) < name){
+            low = middle + 1;
+        }
+        else{
+            high = middle;
+        }
+    }
+
+    if (low < this->size() and this->get_name(low) == name){
+        handle = NodeHandle(low);
+        return true;
+    }
+
+    return false;
+}
+
+
+bool GFANodeTable::find(int64_t id, NodeHandle& handle) const{
+    ///
+    /// Resolve an integer node id, using the direct lookup table when the graph has one, and otherwise searching for
+    /// its decimal representation (formatted on the stack, without allocating)
+    ///
+
+    if (not this->id_offset.empty()){
+        int64_t i = id - this->id_offset[0];
+
+        if (i < 0 or i >= int64_t(this->handles_by_id.size()) or this->handles_by_id[i] == NO_HANDLE){
+            return false;
+        }
+
+        handle = this->handles_by_id[i];
+        return true;
+    }
+
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), id);
+
+    return this->find(string_view(buffer, result.ptr - buffer), handle);
+}
+
+
+ArrayView<uint64_t> GFANodeTable::get_link_lines(NodeHandle handle) const{
+    auto start = this->link_bounds[handle];
+    auto stop = this->link_bounds[handle+1];
+    return {this->link_lines.data() + start, stop - start};
+}
+
+
+size_t GFATagColumn::size() const{
+    return this->present.size();
+}
+
+
+bool GFATagColumn::has_value(size_t i) const{
+    return this->present.at(i) != 0;
+}
+
+
+int64_t GFATagColumn::get_integer(size_t i) const{
+    if (this->tag_type != 'i'){
+        throw runtime_error("ERROR: tag " + this->tag + ':' + this->tag_type + " is not an integer column");
+    }
+
+    return this->integers.at(i);
+}
+
+
+double GFATagColumn::get_float(size_t i) const{
+    if (this->tag_type != 'f'){
+        throw runtime_error("ERROR: tag " + this->tag + ':' + this->tag_type + " is not a float column");
+    }
+
+    return this->floats.at(i);
+}
+
+
+string_view GFATagColumn::get_string(size_t i) const{
+    if (is_numeric(this->tag_type)){
+        throw runtime_error("ERROR: tag " + this->tag + ':' + this->tag_type + " is not a string column");
+    }
+
+    auto start = this->string_bounds.at(i);
+    auto stop = this->string_bounds.at(i+1);
+
+    return {this->strings.data() + start, stop - start};
+}
+
+
+bool GFATagColumn::is_numeric(char tag_type){
+    return tag_type == 'i' or tag_type == 'f';
+}
+
+
+uint64_t get_tag_column_section(char line_type, string_view tag, char tag_type, GFATagColumnPart part){
+    ///
+    /// Every (line type, tag, tag type) gets its own range of section ids above TAG_COLUMNS, with one id per part
+    ///
+
+    if (tag.size() != 2){
+        throw runtime_error("ERROR: GFA tag names must be 2 characters: " + string(tag));
+    }
+
+    uint64_t key = uint64_t(uint8_t(line_type)) << 24 | uint64_t(uint8_t(tag[0])) << 16 | uint64_t(uint8_t(tag[1])) << 8 | uint64_t(uint8_t(tag_type));
+
+    return TAG_COLUMNS + (key << 2) + part;
+}
@@ -0,0 +1,899 @@
+#include "GFAIndexer.hpp"
+#include "GFAReader.hpp"
+#include "BGZFReader.hpp"
+#include "IndexFile.hpp"
+#include "Parallel.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <deque>
+#include <unordered_map>
+#include <sys/stat.h>
+
+using std::runtime_error;
+using std::string;
+using std::unordered_map;
+using std::tuple;
+using std::deque;
+using std::pair;
+using std::get;
+
+
+const char GFAIndexer::EOF_CODE = 'X';
+const uint64_t GFAIndexer::INDEX_CHUNK_SIZE = 16*1024*1024;
+const uint64_t GFAIndexer::INDEX_BGZF_BATCH_SIZE = 64*1024*1024;
+const uint64_t GFAIndexer::INDEX_MAGIC = 0x3149414647;   // "GFAI1" in little endian
+const uint64_t GFAIndexer::INDEX_VERSION = 8;
+
+
+GFAIndexer::GFAIndexer(path gfa_path, path gfa_index_path, size_t n_threads, bool compress_offsets){
+    this->gfa_path = gfa_path;
+    this->gfa_index_path = gfa_index_path;
+    this->n_threads = std::max(size_t(1), n_threads);
+    this->compress_offsets = compress_offsets;
+}
+
+
+void GFAIndexer::write_index_to_binary_file(const GFAIndexBuffers& buffers) const{
+    ///
+    /// Write the index as columns: the type of every line, the byte offset of every line, and then the lines of each
+    /// type stored contiguously, with a table of type codes and their bounds in the concatenated list. The identity
+    /// of the source GFA is stored alongside, so that the index can be validated before it is used.
+    ///
+    /// With compress_offsets, the line offsets and the lines of each type, which are all increasing, are Elias-Fano
+    /// encoded instead, which takes them from 64 bits per entry to a few bits more than log2(average gap).
+    ///
+
+    IndexFileWriter index_file(this->gfa_index_path, INDEX_MAGIC, INDEX_VERSION);
+
+    index_file.write_section(SOURCE_STAMP, buffers.source_stamp);
+
+    index_file.write_section(LINE_TYPES, buffers.types);
+    vector <uint64_t> words;
+
+    if (this->compress_offsets){
+        EliasFano::encode(buffers.offsets.data(), buffers.offsets.size(), words);
+        index_file.write_section(LINE_OFFSETS_COMPRESSED, words);
+    }
+    else{
+        index_file.write_section(LINE_OFFSETS, buffers.offsets);
+    }
+
+    vector <char> type_codes;
+    vector <uint64_t> type_line_bounds = {0};
+    vector <uint64_t> type_lines;
+    vector <uint64_t> compressed_type_lines;
+    vector <uint64_t> compressed_type_line_bounds = {0};
+
+    for (auto& [type, lines]: buffers.lines_by_type){
+        type_codes.emplace_back(type);
+        type_line_bounds.emplace_back(type_line_bounds.back() + lines.size());
+
+        // Each type is encoded on its own, so that every list stays increasing
+        if (this->compress_offsets){
+            EliasFano::encode(lines.data(), lines.size(), words);
+            compressed_type_lines.insert(compressed_type_lines.end(), words.begin(), words.end());
+            compressed_type_line_bounds.emplace_back(compressed_type_lines.size());
+        }
+        else{
+            type_lines.insert(type_lines.end(), lines.begin(), lines.end());
+        }
+    }
+
+    index_file.write_section(TYPE_CODES, type_codes);
+    index_file.write_section(TYPE_LINE_BOUNDS, type_line_bounds);
+
+    if (this->compress_offsets){
+        index_file.write_section(TYPE_LINES_COMPRESSED, compressed_type_lines);
+        index_file.write_section(TYPE_LINES_COMPRESSED_BOUNDS, compressed_type_line_bounds);
+    }
+    else{
+        index_file.write_section(TYPE_LINES, type_lines);
+    }
+
+    index_file.write_section(NODE_NAMES, buffers.node_names);
+    index_file.write_section(NODE_NAME_BOUNDS, buffers.node_name_bounds);
+    index_file.write_section(NODE_SEQUENCE_LINES, buffers.node_sequence_lines);
+    index_file.write_section(NODE_LINK_BOUNDS, buffers.node_link_bounds);
+    index_file.write_section(NODE_LINK_LINES, buffers.node_link_lines);
+    index_file.write_section(NODE_ID_OFFSET, buffers.node_id_offset);
+    index_file.write_section(NODE_HANDLES_BY_ID, buffers.node_handles_by_id);
+    index_file.write_section(ADJACENCY_BOUNDS, buffers.adjacency_bounds);
+    index_file.write_section(ADJACENCY_EDGES, buffers.adjacency_edges);
+    index_file.write_section(SEQUENCE_LENGTHS, buffers.sequence_lengths);
+
+    if (not buffers.bgzf_compressed_offsets.empty()){
+        index_file.write_section(BGZF_COMPRESSED_OFFSETS, buffers.bgzf_compressed_offsets);
+        index_file.write_section(BGZF_UNCOMPRESSED_OFFSETS, buffers.bgzf_uncompressed_offsets);
+    }
+
+    index_file.close();
+}
+
+
+void GFAIndexer::add_sections_to_index(const GFAReader& reader) const{
+    ///
+    /// Append the sections that the reader built on request (tag columns, the sequence store) to the index it has
+    /// mapped. Only the new sections are written, and the existing ones, including any that other processes added in
+    /// the meantime, stay as they are, so the stamp still matches the GFA. A reindex or an extension drops all added
+    /// sections, since they would no longer match the lines of the GFA, and they are built again on request.
+    ///
+
+    reader.index_file->append_sections(reader.added_sections);
+}
+
+
+void find_line_starts(const char* text, uint64_t text_start, uint64_t start, uint64_t stop, vector <uint64_t>& line_starts){
+    ///
+    /// Find every line start that follows a newline located in the range [start, stop), where `text` holds the bytes
+    /// from `text_start` up to at least stop + 1. A line start is only counted if it is not itself a newline, so
+    /// empty lines are folded into the preceding line, as in the original indexer. memchr is used for the newline
+    /// search because glibc implements it with vector instructions.
+    ///
+
+    const char* cursor = text + (start - text_start);
+    const char* end = text + (stop - text_start);
+
+    while (cursor < end){
+        auto newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+
+        if (newline == nullptr){
+            break;
+        }
+
+        uint64_t line_start = text_start + uint64_t(newline - text) + 1;
+
+        if (text[line_start - text_start] != '\n'){
+            line_starts.emplace_back(line_start);
+        }
+
+        cursor = newline + 1;
+    }
+}
+
+
+uint64_t compute_sampled_checksum(const char* data, uint64_t length){
+    ///
+    /// FNV-1a hash of the length plus a fixed number of evenly spaced windows of the first `length` bytes, so that
+    /// validating an index costs the same for any size of GFA. Small files are hashed in full.
+    ///
+
+    const uint64_t n_samples = 64;
+    const uint64_t window_size = 4096;
+    const uint64_t prime = 0x100000001b3;
+
+    uint64_t checksum = 0xcbf29ce484222325;
+
+    auto hash_bytes = [&](const char* bytes, uint64_t n){
+        for (uint64_t i=0; i<n; i++){
+            checksum ^= uint8_t(bytes[i]);
+            checksum *= prime;
+        }
+    };
+
+    hash_bytes(reinterpret_cast<const char*>(&length), sizeof(length));
+
+    if (length <= n_samples*window_size){
+        hash_bytes(data, length);
+        return checksum;
+    }
+
+    uint64_t stride = (length - window_size) / (n_samples - 1);
+    for (uint64_t i=0; i<n_samples; i++){
+        hash_bytes(data + i*stride, window_size);
+    }
+
+    return checksum;
+}
+
+
+GFASourceStamp get_source_stamp(const MappedFile& gfa_file){
+    struct stat file_stats;
+
+    if (::fstat(gfa_file.file_descriptor, &file_stats) != 0){
+        throw runtime_error("ERROR: could not stat file: " + gfa_file.file_path.string());
+    }
+
+    GFASourceStamp stamp;
+    stamp.file_size = gfa_file.size;
+    stamp.mtime_seconds = file_stats.st_mtim.tv_sec;
+    stamp.mtime_nanoseconds = file_stats.st_mtim.tv_nsec;
+    stamp.checksum = compute_sampled_checksum(gfa_file.data, gfa_file.size);
+
+    return stamp;
+}
+
+
+GFAIndexStatus GFAIndexer::check_index_status(const GFAReader& reader) const{
+    ///
+    /// Compare the stamp stored in the loaded index against the GFA on disk. The GFA is only considered unchanged if
+    /// size, modification time and checksum all agree. If it is larger, and the checksum of its first `file_size`
+    /// bytes still matches, then it was only appended to, and the existing entries can be kept.
+    ///
+
+    auto indexed_stamp = reader.index_file->get_section<GFASourceStamp>(SOURCE_STAMP).at(0);
+
+    MappedFile gfa_file(this->gfa_path);
+    auto current_stamp = get_source_stamp(gfa_file);
+
+    if (current_stamp.file_size == indexed_stamp.file_size
+        and current_stamp.mtime_seconds == indexed_stamp.mtime_seconds
+        and current_stamp.mtime_nanoseconds == indexed_stamp.mtime_nanoseconds
+        and current_stamp.checksum == indexed_stamp.checksum){
+        return INDEX_CURRENT;
+    }
+
+    // Appending is only handled for plain text, a compressed GFA is simply reindexed
+    if (current_stamp.file_size > indexed_stamp.file_size
+        and indexed_stamp.file_size > 0
+        and reader.bgzf_reader == nullptr
+        and reader.line_offsets.back().offset == indexed_stamp.file_size
+        and compute_sampled_checksum(gfa_file.data, indexed_stamp.file_size) == indexed_stamp.checksum){
+        return INDEX_APPENDED;
+    }
+
+    return INDEX_STALE;
+}
+
+
+void GFAIndexer::index_lines(const char* data, uint64_t size, uint64_t start, GFAIndexBuffers& buffers) const{
+    ///
+    /// Append an entry for every line that starts at or after `start`, followed by the EOF placeholder
+    ///
+
+    this->index_line_range(data, 0, start, size, buffers);
+
+    // Append a placeholder to tell the total length of the file
+    buffers.types.emplace_back(this->EOF_CODE);
+    buffers.offsets.emplace_back(size);
+}
+
+
+void GFAIndexer::index_line_range(const char* text, uint64_t text_start, uint64_t start, uint64_t stop, GFAIndexBuffers& buffers) const{
+    ///
+    /// Append an entry for every line that starts in [start, stop). Lines are found by scanning for the newlines which
+    /// precede them, so `text`, which holds the GFA from `text_start` up to `stop`, must also include the byte before
+    /// `start`, unless `start` is 0.
+    ///
+
+    uint64_t scan_start = (start > 0) ? start - 1 : 0;
+    uint64_t scan_stop = std::max(scan_start, (stop > 0) ? stop - 1 : 0);
+
+    // Split the range into fixed size chunks, and let each thread claim chunks until there are none left
+    size_t n_chunks = (scan_stop - scan_start + INDEX_CHUNK_SIZE - 1) / INDEX_CHUNK_SIZE;
+    vector <vector <uint64_t> > line_starts_per_chunk(n_chunks);
+
+    run_jobs_in_parallel(n_chunks, this->n_threads, [&](size_t c){
+        uint64_t chunk_start = scan_start + c*INDEX_CHUNK_SIZE;
+        uint64_t chunk_stop = std::min(scan_stop, chunk_start + INDEX_CHUNK_SIZE);
+
+        find_line_starts(text, text_start, chunk_start, chunk_stop, line_starts_per_chunk[c]);
+    });
+
+    // Stitch the chunks together in file order. Build a map which lists all the positions in the index vector for
+    // each line type (e.g. S,L,H,U, etc.), so they can be iterated even if they are not grouped or in order (which is
+    // not required by the GFA format spec)
+    if (start == 0 and stop > 0 and text[0] != '\n'){
+        buffers.lines_by_type[text[0]].emplace_back(buffers.offsets.size());
+        buffers.types.emplace_back(text[0]);
+        buffers.offsets.emplace_back(0);
+    }
+
+    for (auto& line_starts: line_starts_per_chunk){
+        for (auto& offset: line_starts){
+            char gfa_type_code = text[offset - text_start];
+            buffers.lines_by_type[gfa_type_code].emplace_back(buffers.offsets.size());
+            buffers.types.emplace_back(gfa_type_code);
+            buffers.offsets.emplace_back(offset);
+        }
+    }
+}
+
+
+void split_gfa_line(string_view line, vector <string_view>& fields, size_t max_fields){
+    ///
+    /// Split a GFA line into at most `max_fields` tab separated fields, without copying. The terminating newline (and
+    /// any blank lines that were folded into this line by the indexer) are excluded.
+    ///
+
+    fields.clear();
+
+    while (not line.empty() and (line.back() == '\n' or line.back() == '\r')){
+        line.remove_suffix(1);
+    }
+
+    size_t start = 0;
+    while (fields.size() < max_fields){
+        auto stop = line.find('\t', start);
+
+        if (stop == string_view::npos){
+            fields.emplace_back(line.substr(start));
+            break;
+        }
+
+        fields.emplace_back(line.substr(start, stop - start));
+        start = stop + 1;
+    }
+}
+
+
+void index_integer_node_ids(GFAIndexBuffers& buffers){
+    ///
+    /// If every node name is a canonical decimal integer, and the ids are reasonably dense, build a table that maps
+    /// (id - smallest id) directly to a handle. Otherwise both sections are left empty.
+    ///
+
+    buffers.node_id_offset.clear();
+    buffers.node_handles_by_id.clear();
+
+    auto n_nodes = buffers.node_sequence_lines.size();
+
+    if (n_nodes == 0){
+        return;
+    }
+
+    vector <int64_t> ids(n_nodes);
+
+    for (size_t i=0; i<n_nodes; i++){
+        auto start = buffers.node_name_bounds[i];
+        auto stop = buffers.node_name_bounds[i+1];
+        const char* name = buffers.node_names.data() + start;
+
+        // Reject anything that would not format back to the same name, e.g. "+1", "007" or "-0"
+        bool has_leading_zero = (stop - start > 1 and name[0] == '0');
+        auto result = std::from_chars(name, name + (stop - start), ids[i]);
+
+        if (has_leading_zero or name[0] == '-' or result.ec != std::errc() or result.ptr != name + (stop - start)){
+            return;
+        }
+    }
+
+    auto [min_id, max_id] = std::minmax_element(ids.begin(), ids.end());
+    uint64_t range = uint64_t(*max_id - *min_id) + 1;
+
+    if (range > 4*n_nodes + 65536){
+        return;
+    }
+
+    buffers.node_id_offset = {*min_id};
+    buffers.node_handles_by_id.assign(range, GFANodeTable::NO_HANDLE);
+
+    for (size_t i=0; i<n_nodes; i++){
+        buffers.node_handles_by_id[ids[i] - *min_id] = NodeHandle(i);
+    }
+}
+
+
+void parse_overlap_lengths(string_view cigar, uint32_t& length_a, uint32_t& length_b){
+    ///
+    /// Count how many bases of each node a GFA link overlap CIGAR spans. M, = and X consume both nodes, D consumes
+    /// only the first and I only the second. A missing overlap ("*") has length 0.
+    ///
+
+    length_a = 0;
+    length_b = 0;
+
+    if (cigar == "*"){
+        return;
+    }
+
+    uint32_t count = 0;
+    for (auto c: cigar){
+        if (c >= '0' and c <= '9'){
+            count = count*10 + uint32_t(c - '0');
+            continue;
+        }
+
+        if (c == 'M' or c == '=' or c == 'X'){
+            length_a += count;
+            length_b += count;
+        }
+        else if (c == 'D' or c == 'N'){
+            length_a += count;
+        }
+        else if (c == 'I' or c == 'S'){
+            length_b += count;
+        }
+        else if (c != 'H' and c != 'P'){
+            throw runtime_error("ERROR: invalid operation in overlap CIGAR: " + string(cigar));
+        }
+
+        count = 0;
+    }
+}
+
+
+class GFAPendingEdge;
+void index_edges(GFAIndexBuffers& buffers, vector <GFAPendingEdge>& pending_edges, size_t n_threads);
+
+
+class GFAPendingEdge{
+public:
+    ///
+    /// An adjacency entry whose endpoints are still names, before handles have been assigned
+    ///
+
+    /// Attributes ///
+    string_view source;
+    string_view neighbor;
+    GFAEdge edge;
+};
+
+
+class GFANodeEntries{
+public:
+    ///
+    /// The S and L lines of a GFA, reduced to what the node table is built from. Names are views, either of the GFA
+    /// text or, once the text is released, of `name_storage`.
+    ///
+
+    /// Attributes ///
+    vector <tuple <string_view, uint64_t, uint64_t> > sequence_entries;     // (name, line index, length)
+    vector <pair <string_view, uint64_t> > link_entries;                   // (name, line index) of each L line endpoint
+    vector <GFAPendingEdge> pending_edges;
+    deque <string> name_storage;
+
+    /// Methods ///
+    void store_names(size_t first_sequence_entry, size_t first_link_entry, size_t first_pending_edge);
+};
+
+
+void GFANodeEntries::store_names(size_t first_sequence_entry, size_t first_link_entry, size_t first_pending_edge){
+    ///
+    /// Copy the names of the entries from the given positions on out of the text they point into. The same field is
+    /// referenced several times (an L line gives two link entries and two edges), so each field is stored only once.
+    ///
+
+    unordered_map <const char*, uint64_t> name_offsets;
+    uint64_t n_bytes = 0;
+
+    auto for_each_name = [&](auto f){
+        for (size_t i=first_sequence_entry; i<this->sequence_entries.size(); i++){
+            f(get<0>(this->sequence_entries[i]));
+        }
+        for (size_t i=first_link_entry; i<this->link_entries.size(); i++){
+            f(this->link_entries[i].first);
+        }
+        for (size_t i=first_pending_edge; i<this->pending_edges.size(); i++){
+            f(this->pending_edges[i].source);
+            f(this->pending_edges[i].neighbor);
+        }
+    };
+
+    for_each_name([&](string_view& name){
+        if (name_offsets.try_emplace(name.data(), n_bytes).second){
+            n_bytes += name.size();
+        }
+    });
+
+    // Elements of a deque never move, so views of earlier storage stay valid
+    auto& storage = this->name_storage.emplace_back(n_bytes, '\0');
+
+    for_each_name([&](string_view& name){
+        auto offset = name_offsets.at(name.data());
+        memcpy(storage.data() + offset, name.data(), name.size());
+        name = string_view(storage.data() + offset, name.size());
+    });
+}
+
+
+uint64_t GFAIndexer::parse_sequence_length(const vector <string_view>& fields, uint64_t line_index) const{
+    ///
+    /// Length of a segment from its S line fields: the LN:i tag if present, otherwise the length of the sequence
+    /// field, where an omitted sequence ("*") has length 0
+    ///
+
+    for (size_t i=3; i<fields.size(); i++){
+        if (fields[i].substr(0,5) == "LN:i:"){
+            uint64_t length;
+            auto tag_value = fields[i].substr(5);
+            auto result = std::from_chars(tag_value.data(), tag_value.data() + tag_value.size(), length);
+
+            if (result.ec != std::errc() or result.ptr != tag_value.data() + tag_value.size()){
+                throw runtime_error("ERROR: invalid LN tag at GFA line " + std::to_string(line_index) + " in " + this->gfa_path.string());
+            }
+
+            return length;
+        }
+    }
+
+    if (fields.size() < 3 or fields[2] == "*"){
+        return 0;
+    }
+
+    return fields[2].size();
+}
+
+
+bool parse_orientation(string_view field, uint32_t& reversed){
+    if (field == "+"){
+        reversed = 0;
+        return true;
+    }
+    if (field == "-"){
+        reversed = 1;
+        return true;
+    }
+    return false;
+}
+
+
+void index_edges(GFAIndexBuffers& buffers, vector <GFAPendingEdge>& pending_edges, size_t n_threads){
+    ///
+    /// Resolve the endpoint names of every adjacency entry to handles, and arrange the entries in compressed sparse
+    /// row order: the edges of node i are edges[bounds[i], bounds[i+1]), sorted by L line
+    ///
+
+    const size_t edges_per_job = 65536;
+
+    // Search the table that is being built, through views of the buffers
+    GFANodeTable table;
+    table.names = {buffers.node_names.data(), buffers.node_names.size()};
+    table.name_bounds = {buffers.node_name_bounds.data(), buffers.node_name_bounds.size()};
+    table.sequence_lines = {buffers.node_sequence_lines.data(), buffers.node_sequence_lines.size()};
+
+    vector <NodeHandle> sources(pending_edges.size());
+    size_t n_jobs = (pending_edges.size() + edges_per_job - 1) / edges_per_job;
+
+    run_jobs_in_parallel(n_jobs, n_threads, [&](size_t j){
+        size_t stop = std::min(pending_edges.size(), (j+1)*edges_per_job);
+
+        for (size_t i=j*edges_per_job; i<stop; i++){
+            auto& pending = pending_edges[i];
+            table.find(pending.source, sources[i]);
+            table.find(pending.neighbor, pending.edge.neighbor);
+        }
+    });
+
+    auto n_nodes = table.size();
+    buffers.adjacency_bounds.assign(n_nodes + 1, 0);
+
+    for (auto& source: sources){
+        buffers.adjacency_bounds[source + 1]++;
+    }
+    for (size_t i=0; i<n_nodes; i++){
+        buffers.adjacency_bounds[i + 1] += buffers.adjacency_bounds[i];
+    }
+
+    buffers.adjacency_edges.assign(pending_edges.size(), GFAEdge());
+    vector <uint64_t> cursors(buffers.adjacency_bounds.begin(), buffers.adjacency_bounds.end() - 1);
+
+    for (size_t i=0; i<pending_edges.size(); i++){
+        buffers.adjacency_edges[cursors[sources[i]]++] = pending_edges[i].edge;
+    }
+
+    // Order each node's edges by line, so that rebuilding or extending an index always gives the same result
+    run_jobs_in_parallel(n_nodes, n_threads, [&](size_t i){
+        auto begin = buffers.adjacency_edges.begin() + buffers.adjacency_bounds[i];
+        auto end = buffers.adjacency_edges.begin() + buffers.adjacency_bounds[i+1];
+
+        std::sort(begin, end, [](const GFAEdge& a, const GFAEdge& b){
+            return std::tie(a.line_index, a.reversed) < std::tie(b.line_index, b.reversed);
+        });
+    });
+}
+
+
+void GFAIndexer::index_nodes(const char* data, size_t first_line, const GFAReader* previous, GFAIndexBuffers& buffers) const{
+    ///
+    /// Build the table of node names, listing the S line and every L line of each node, and the adjacency of each
+    /// node. Only the S and L lines numbered `first_line` or greater are parsed. Entries for earlier lines are taken
+    /// from the `previous` reader's index, so that extending an index does not reread the unchanged part of the GFA.
+    /// Entries in the previous index for lines at or after `first_line` are discarded.
+    ///
+
+    GFANodeEntries entries;
+    auto& sequence_entries = entries.sequence_entries;
+    auto& link_entries = entries.link_entries;
+    auto& pending_edges = entries.pending_edges;
+
+    if (first_line > 0){
+        auto& node_table = previous->node_table;
+
+        for (NodeHandle i=0; i<node_table.size(); i++){
+            auto name = node_table.get_name(i);
+            auto sequence_line = node_table.sequence_lines[i];
+
+            if (sequence_line != GFANodeTable::NO_LINE and sequence_line < first_line){
+                sequence_entries.emplace_back(name, sequence_line, previous->sequence_lengths[i]);
+            }
+            for (auto& line_index: node_table.get_link_lines(i)){
+                if (line_index < first_line){
+                    link_entries.emplace_back(name, line_index);
+                }
+            }
+            for (auto& edge: previous->get_edges(i)){
+                if (edge.line_index < first_line){
+                    pending_edges.push_back({name, node_table.get_name(edge.neighbor), edge});
+                }
+            }
+        }
+    }
+
+    this->collect_node_entries(data, 0, buffers.offsets.back(), first_line, buffers, entries);
+    this->build_node_table(entries, buffers);
+}
+
+
+void GFAIndexer::collect_node_entries(const char* text, uint64_t text_start, uint64_t text_stop, size_t first_line, const GFAIndexBuffers& buffers, GFANodeEntries& entries) const{
+    ///
+    /// Parse the S and L lines numbered `first_line` or greater, which must all lie within `text`, holding the GFA from
+    /// `text_start` to `text_stop`. The last line ends at `text_stop` if the following line is not indexed yet.
+    ///
+
+    const size_t lines_per_job = 65536;
+
+    // Parse every new line of one type in parallel, each job collecting its results in its own slot
+    auto parse_lines = [&](char type, size_t min_fields, size_t max_fields, auto& results_per_job, auto parse_fields){
+        if (buffers.lines_by_type.count(type) == 0){
+            return;
+        }
+
+        auto& lines = buffers.lines_by_type.at(type);
+        size_t first = std::lower_bound(lines.begin(), lines.end(), first_line) - lines.begin();
+        size_t n_jobs = (lines.size() - first + lines_per_job - 1) / lines_per_job;
+        results_per_job.resize(n_jobs);
+
+        run_jobs_in_parallel(n_jobs, this->n_threads, [&](size_t j){
+            vector <string_view> fields;
+            size_t stop = std::min(lines.size(), first + (j+1)*lines_per_job);
+
+            for (size_t i=first + j*lines_per_job; i<stop; i++){
+                auto line_index = lines[i];
+                auto offset = buffers.offsets[line_index];
+                auto line_stop = (line_index + 1 < buffers.offsets.size()) ? buffers.offsets[line_index + 1] : text_stop;
+                string_view line(text + (offset - text_start), line_stop - offset);
+
+                split_gfa_line(line, fields, max_fields);
+
+                if (fields.size() < min_fields){
+                    throw runtime_error("ERROR: malformed GFA line " + std::to_string(line_index) + " in " + this->gfa_path.string());
+                }
+
+                parse_fields(fields, line_index, results_per_job[j]);
+            }
+        });
+    };
+
+    vector <vector <tuple <string_view, uint64_t, uint64_t> > > sequence_entries_per_job;
+
+    parse_lines('S', 2, std::numeric_limits<size_t>::max(), sequence_entries_per_job, [&](auto& fields, uint64_t line_index, auto& job_entries){
+        job_entries.emplace_back(fields[1], line_index, parse_sequence_length(fields, line_index));
+    });
+
+    vector <pair <vector <pair <string_view, uint64_t> >, vector <GFAPendingEdge> > > link_results_per_job;
+
+    parse_lines('L', 6, 6, link_results_per_job, [&](auto& fields, uint64_t line_index, auto& results){
+        GFAEdge forward = {};
+        GFAEdge reverse = {};
+        uint32_t reversed_a;
+        uint32_t reversed_b;
+
+        if (not parse_orientation(fields[2], reversed_a) or not parse_orientation(fields[4], reversed_b)){
+            throw runtime_error("ERROR: invalid link orientation at GFA line " + std::to_string(line_index) + " in " + this->gfa_path.string());
+        }
+
+        // The link A -> B, as seen from A, is equivalent to the link B' -> A' (opposite orientations), seen from B
+        forward.line_index = line_index;
+        forward.reversed = reversed_a;
+        forward.neighbor_reversed = reversed_b;
+
+        reverse.line_index = line_index;
+        reverse.reversed = 1 - reversed_b;
+        reverse.neighbor_reversed = 1 - reversed_a;
+
+        parse_overlap_lengths(fields[5], forward.overlap_length, reverse.overlap_length);
+
+        results.first.emplace_back(fields[1], line_index);
+        results.first.emplace_back(fields[3], line_index);
+        results.second.push_back({fields[1], fields[3], forward});
+        results.second.push_back({fields[3], fields[1], reverse});
+    });
+
+    for (auto& job_entries: sequence_entries_per_job){
+        entries.sequence_entries.insert(entries.sequence_entries.end(), job_entries.begin(), job_entries.end());
+    }
+    for (auto& [job_entries, job_edges]: link_results_per_job){
+        entries.link_entries.insert(entries.link_entries.end(), job_entries.begin(), job_entries.end());
+        entries.pending_edges.insert(entries.pending_edges.end(), job_edges.begin(), job_edges.end());
+    }
+}
+
+
+void GFAIndexer::build_node_table(GFANodeEntries& entries, GFAIndexBuffers& buffers) const{
+    auto& sequence_entries = entries.sequence_entries;
+    auto& link_entries = entries.link_entries;
+    auto& pending_edges = entries.pending_edges;
+
+    // Sort by name, and by line within each name, then drop repeats (a link from a node to itself)
+    std::sort(sequence_entries.begin(), sequence_entries.end());
+    std::sort(link_entries.begin(), link_entries.end());
+    link_entries.erase(std::unique(link_entries.begin(), link_entries.end()), link_entries.end());
+
+    buffers.node_names.clear();
+    buffers.node_name_bounds = {0};
+    buffers.node_sequence_lines.clear();
+    buffers.sequence_lengths.clear();
+    buffers.node_link_bounds = {0};
+    buffers.node_link_lines.clear();
+
+    // Merge the two sorted lists, creating one table entry per distinct name
+    size_t s = 0;
+    size_t l = 0;
+    while (s < sequence_entries.size() or l < link_entries.size()){
+        string_view name;
+        if (l == link_entries.size() or (s < sequence_entries.size() and get<0>(sequence_entries[s]) <= link_entries[l].first)){
+            name = get<0>(sequence_entries[s]);
+        }
+        else{
+            name = link_entries[l].first;
+        }
+
+        buffers.node_names.insert(buffers.node_names.end(), name.begin(), name.end());
+        buffers.node_name_bounds.emplace_back(buffers.node_names.size());
+
+        if (s < sequence_entries.size() and get<0>(sequence_entries[s]) == name){
+            buffers.node_sequence_lines.emplace_back(get<1>(sequence_entries[s]));
+            buffers.sequence_lengths.emplace_back(get<2>(sequence_entries[s]));
+            s++;
+
+            // Only the first S line of a node is kept if it is (illegally) defined more than once
+            while (s < sequence_entries.size() and get<0>(sequence_entries[s]) == name){
+                s++;
+            }
+        }
+        else{
+            buffers.node_sequence_lines.emplace_back(GFANodeTable::NO_LINE);
+            buffers.sequence_lengths.emplace_back(0);
+        }
+
+        while (l < link_entries.size() and link_entries[l].first == name){
+            buffers.node_link_lines.emplace_back(link_entries[l].second);
+            l++;
+        }
+        buffers.node_link_bounds.emplace_back(buffers.node_link_lines.size());
+    }
+
+    auto n_nodes = buffers.node_sequence_lines.size();
+
+    if (n_nodes >= GFANodeTable::NO_HANDLE){
+        throw runtime_error("ERROR: too many nodes to assign handles in " + this->gfa_path.string());
+    }
+
+    index_integer_node_ids(buffers);
+    index_edges(buffers, pending_edges, this->n_threads);
+}
+
+
+void GFAIndexer::index() const{
+    MappedFile gfa_file(this->gfa_path);
+    GFAIndexBuffers buffers;
+
+    buffers.source_stamp = get_source_stamp(gfa_file);
+
+    if (BGZFReader::is_bgzf(gfa_file.data, gfa_file.size)){
+        this->index_bgzf(buffers);
+    }
+    else if (BGZFReader::is_gzip(gfa_file.data, gfa_file.size)){
+        throw runtime_error("ERROR: GFA is gzip compressed but not BGZF, recompress it with bgzip: " + this->gfa_path.string());
+    }
+    else{
+        this->index_lines(gfa_file.data, gfa_file.size, 0, buffers);
+        this->index_nodes(gfa_file.data, 0, nullptr, buffers);
+    }
+
+    this->write_index_to_binary_file(buffers);
+}
+
+
+void GFAIndexer::index_bgzf(GFAIndexBuffers& buffers) const{
+    ///
+    /// Index a BGZF compressed GFA without holding all of its text. Batches of whole blocks are decompressed in
+    /// parallel, and the complete lines of each batch are indexed. The incomplete line at the end of a batch is carried
+    /// over to the next one, along with the newline before it, which the line scan starts from. Node names are copied
+    /// out of each batch, so memory is bounded by the batch size, the longest line, and the node table itself. All
+    /// offsets refer to the uncompressed text.
+    ///
+
+    BGZFReader bgzf_reader(this->gfa_path);
+    bgzf_reader.index_blocks();
+
+    auto n_blocks = bgzf_reader.get_block_count();
+    auto& block_offsets = bgzf_reader.uncompressed_offsets;
+
+    GFANodeEntries entries;
+    vector <char> text;
+    uint64_t text_start = 0;
+    uint64_t start = 0;
+
+    size_t b = 0;
+    while (b < n_blocks){
+        // As many whole blocks as fit in a batch, and at least one
+        size_t stop_block = b + 1;
+        while (stop_block < n_blocks and block_offsets[stop_block + 1] - block_offsets[b] <= INDEX_BGZF_BATCH_SIZE){
+            stop_block++;
+        }
+
+        auto n_carried = text.size();
+        text.resize(n_carried + block_offsets[stop_block] - block_offsets[b]);
+        bgzf_reader.decompress_blocks(b, stop_block, text.data() + n_carried, this->n_threads);
+        b = stop_block;
+
+        // Index up to the last newline, or to the end of the file. A line longer than a batch takes several batches.
+        uint64_t stop = text_start + text.size();
+
+        if (b < n_blocks){
+            auto unindexed = text.data() + (start - text_start);
+            auto last_newline = static_cast<const char*>(memrchr(unindexed, '\n', text.data() + text.size() - unindexed));
+
+            if (last_newline == nullptr){
+                continue;
+            }
+
+            stop = text_start + uint64_t(last_newline - text.data()) + 1;
+        }
+
+        auto first_line = buffers.offsets.size();
+        auto n_sequence_entries = entries.sequence_entries.size();
+        auto n_link_entries = entries.link_entries.size();
+        auto n_pending_edges = entries.pending_edges.size();
+
+        this->index_line_range(text.data(), text_start, start, stop, buffers);
+        this->collect_node_entries(text.data(), text_start, stop, first_line, buffers, entries);
+        entries.store_names(n_sequence_entries, n_link_entries, n_pending_edges);
+
+        if (stop > start){
+            text.erase(text.begin(), text.begin() + (stop - 1 - text_start));
+            text_start = stop - 1;
+            start = stop;
+        }
+    }
+
+    // Placeholder for the total length of the file, as in index_lines()
+    buffers.types.emplace_back(this->EOF_CODE);
+    buffers.offsets.emplace_back(bgzf_reader.get_uncompressed_size());
+
+    this->build_node_table(entries, buffers);
+
+    buffers.bgzf_compressed_offsets = bgzf_reader.compressed_offsets;
+    buffers.bgzf_uncompressed_offsets = bgzf_reader.uncompressed_offsets;
+}
+
+
+void GFAIndexer::extend_index(const GFAReader& previous) const{
+    ///
+    /// Incrementally refresh an index whose GFA has only been appended to: the existing entries are kept, and only
+    /// the bytes after the previous end of file are scanned. The previous index stays mapped by `previous` until the
+    /// new one has replaced it on disk, so its entries can be used in place.
+    ///
+
+    MappedFile gfa_file(this->gfa_path);
+
+    // Copy everything but the EOF placeholder, which is replaced by the entries for the new lines
+    auto n_lines = previous.line_offsets.size() - 1;
+    uint64_t previous_size = previous.line_offsets.back().offset;
+
+    GFAIndexBuffers buffers;
+    buffers.types.assign(previous.line_offsets.types.begin(), previous.line_offsets.types.begin() + n_lines);
+    buffers.offsets.assign(previous.line_offsets.offsets.begin(), previous.line_offsets.offsets.begin() + n_lines);
+
+    for (auto& [type, lines]: previous.line_indexes_by_type){
+        buffers.lines_by_type[type].assign(lines.begin(), lines.end());
+    }
+
+    // If the previous last line had no newline, then the appended bytes continue it, so it has to be parsed again
+    size_t first_changed_line = n_lines;
+    if (n_lines > 0 and gfa_file.data[previous_size - 1] != '\n'){
+        first_changed_line = n_lines - 1;
+    }
+
+    this->index_lines(gfa_file.data, gfa_file.size, previous_size, buffers);
+    this->index_nodes(gfa_file.data, first_changed_line, &previous, buffers);
+    buffers.source_stamp = get_source_stamp(gfa_file);
+
+    this->write_index_to_binary_file(buffers);
+}
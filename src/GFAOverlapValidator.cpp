@@ -0,0 +1,325 @@
+#include "GFAOverlapValidator.hpp"
+#include "GFAIndexer.hpp"
+#include "Parallel.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using std::runtime_error;
+
+
+CigarStats& CigarStats::operator+=(const CigarStats& other){
+    this->n_matches += other.n_matches;
+    this->n_mismatches += other.n_mismatches;
+    this->n_inserts += other.n_inserts;
+    this->n_deletes += other.n_deletes;
+    return *this;
+}
+
+
+string CigarStats::to_string() const{
+    return std::to_string(this->n_matches) + '\t' + std::to_string(this->n_mismatches) + '\t' + std::to_string(this->n_inserts) + '\t' + std::to_string(this->n_deletes);
+}
+
+
+bool OverlapValidation::is_valid() const{
+    return this->true_stats.n_mismatches == 0 and this->warning.empty();
+}
+
+
+string OverlapValidation::get_link_string() const{
+    ///
+    /// Same format as the Link class of scripts/test_gfa_overlaps.py, e.g.: + - [('M', 4)]
+    ///
+
+    string s;
+    s += (this->reversed_a ? '-' : '+');
+    s += ' ';
+    s += (this->reversed_b ? '-' : '+');
+    s += " [";
+
+    for (size_t i=0; i<this->cigar.size(); i++){
+        if (i > 0){
+            s += ", ";
+        }
+        s += "('" + string(1, this->cigar[i].first) + "', " + std::to_string(this->cigar[i].second) + ")";
+    }
+
+    s += ']';
+    return s;
+}
+
+
+uint64_t count_mismatches(const char* a, const char* b, uint64_t length){
+    ///
+    /// Compare 16 bytes at a time where SSE2 is available: bytewise equality gives a mask with one bit per byte,
+    /// and the unset bits are the mismatches
+    ///
+
+    uint64_t n_mismatches = 0;
+    uint64_t i = 0;
+
+#ifdef __SSE2__
+    for (; i + 16 <= length; i += 16){
+        auto x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        auto y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        auto equal = uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        n_mismatches += 16 - uint64_t(__builtin_popcount(equal));
+    }
+#endif
+
+    for (; i < length; i++){
+        n_mismatches += (a[i] != b[i]);
+    }
+
+    return n_mismatches;
+}
+
+
+char complement_base(char c){
+    switch (c){
+        case 'A': return 'T';
+        case 'C': return 'G';
+        case 'G': return 'C';
+        case 'T': return 'A';
+        case 'a': return 't';
+        case 'c': return 'g';
+        case 'g': return 'c';
+        case 't': return 'a';
+        default: return c;
+    }
+}
+
+
+void get_oriented_window(string_view sequence, bool reversed, bool from_end, uint64_t length, string& window){
+    ///
+    /// Take `length` bases from the start or end of the sequence as it reads in the given orientation. The end of a
+    /// reversed sequence is the reverse complement of the start of the forward one, and vice versa.
+    ///
+
+    bool take_end = (from_end != reversed);
+    auto start = take_end ? sequence.size() - length : 0;
+    auto bases = sequence.substr(start, length);
+
+    window.assign(bases.begin(), bases.end());
+
+    if (reversed){
+        std::reverse(window.begin(), window.end());
+        std::transform(window.begin(), window.end(), window.begin(), complement_base);
+    }
+}
+
+
+GFAOverlapValidator::GFAOverlapValidator(const GFAReader& gfa_reader, size_t n_threads):
+    gfa_reader(gfa_reader),
+    n_threads(std::max(size_t(1), n_threads))
+{}
+
+
+void GFAOverlapValidator::validate_link(uint64_t line_index, OverlapValidation& result) const{
+    result = {};
+    result.line_index = line_index;
+
+    string line;
+    vector <string_view> fields;
+
+    this->gfa_reader.read_line(line, line_index);
+    split_gfa_line(line, fields, 6);
+
+    if (fields.size() < 6 or not parse_orientation(fields[2], result.reversed_a) or not parse_orientation(fields[4], result.reversed_b)){
+        result.warning += "ERROR: malformed L line " + std::to_string(line_index) + '\n';
+        return;
+    }
+
+    result.node_a = fields[1];
+    result.node_b = fields[3];
+
+    // Parse the CIGAR once, into (operation, length) pairs
+    uint64_t count = 0;
+    uint64_t length_a = 0;
+    uint64_t length_b = 0;
+    bool is_cigar_valid = true;
+
+    for (auto c: fields[5]){
+        if (c >= '0' and c <= '9'){
+            count = count*10 + uint64_t(c - '0');
+            continue;
+        }
+
+        if (c == 'M' or c == '=' or c == 'X'){
+            length_a += count;
+            length_b += count;
+            c = 'M';
+        }
+        else if (c == 'I'){
+            length_b += count;
+        }
+        else if (c == 'D'){
+            length_a += count;
+        }
+        else if (c != '*'){
+            result.warning += "ERROR: invalid cigar operation: " + string(1, c) + '\n';
+            is_cigar_valid = false;
+        }
+
+        if (c != '*'){
+            result.cigar.emplace_back(c, count);
+        }
+        count = 0;
+    }
+
+    // Fetch both sequences
+    string sequence_lines[2];
+    string_view sequences[2];
+    string node_names[2] = {result.node_a, result.node_b};
+
+    for (size_t i=0; i<2; i++){
+        NodeHandle handle;
+
+        if (not this->gfa_reader.find_node_handle(node_names[i], handle) or this->gfa_reader.node_table.sequence_lines[handle] == GFANodeTable::NO_LINE){
+            result.warning += "ERROR: no sequence found for node " + node_names[i] + '\n';
+            return;
+        }
+
+        this->gfa_reader.read_line(sequence_lines[i], this->gfa_reader.get_sequence_line_index(handle));
+        split_gfa_line(sequence_lines[i], fields, 4);
+
+        if (fields.size() < 3 or fields[2] == "*"){
+            result.warning += "ERROR: no sequence found for node " + node_names[i] + '\n';
+            return;
+        }
+
+        sequences[i] = fields[2];
+    }
+
+    if (length_a > sequences[0].size()){
+        result.warning += "ERROR: invalid alignment length " + std::to_string(length_a) + " for sequence length " + std::to_string(sequences[0].size()) + '\n';
+    }
+    if (length_b > sequences[1].size()){
+        result.warning += "ERROR: invalid alignment length " + std::to_string(length_b) + " for sequence length " + std::to_string(sequences[1].size()) + '\n';
+    }
+    if (not is_cigar_valid or not result.warning.empty()){
+        return;
+    }
+
+    // Orient the overlapping bases so that every operation is a forward comparison
+    string window_a;
+    string window_b;
+    get_oriented_window(sequences[0], result.reversed_a, true, length_a, window_a);
+    get_oriented_window(sequences[1], result.reversed_b, false, length_b, window_b);
+
+    uint64_t index_a = 0;
+    uint64_t index_b = 0;
+
+    for (auto& [operation, n]: result.cigar){
+        if (operation == 'M'){
+            auto n_mismatches = count_mismatches(window_a.data() + index_a, window_b.data() + index_b, n);
+            result.gfa_stats.n_matches += n;
+            result.true_stats.n_matches += n - n_mismatches;
+            result.true_stats.n_mismatches += n_mismatches;
+            index_a += n;
+            index_b += n;
+        }
+        else if (operation == 'I'){
+            result.gfa_stats.n_inserts += n;
+            result.true_stats.n_inserts += n;
+            index_b += n;
+        }
+        else if (operation == 'D'){
+            result.gfa_stats.n_deletes += n;
+            result.true_stats.n_deletes += n;
+            index_a += n;
+        }
+    }
+
+    if (result.is_valid()){
+        return;
+    }
+
+    // Only links that are reported get a printable alignment
+    string alignment_a;
+    string alignment_ab;
+    string alignment_b;
+    index_a = 0;
+    index_b = 0;
+
+    for (auto& [operation, n]: result.cigar){
+        for (uint64_t i=0; i<n; i++){
+            if (operation == 'M'){
+                alignment_a += window_a[index_a];
+                alignment_ab += (window_a[index_a] == window_b[index_b]) ? '|' : ' ';
+                alignment_b += window_b[index_b];
+                index_a++;
+                index_b++;
+            }
+            else if (operation == 'I'){
+                alignment_a += '-';
+                alignment_ab += ' ';
+                alignment_b += window_b[index_b];
+                index_b++;
+            }
+            else if (operation == 'D'){
+                alignment_a += window_a[index_a];
+                alignment_ab += ' ';
+                alignment_b += '-';
+                index_a++;
+            }
+        }
+    }
+
+    result.alignment = alignment_a + '\n' + alignment_ab + '\n' + alignment_b;
+}
+
+
+void GFAOverlapValidator::validate(const function<void(const OverlapValidation& result)>& on_invalid_link, CigarStats& total_true_stats, CigarStats& total_gfa_stats) const{
+    ///
+    /// Validate every L line, in parallel chunks. Invalid links are reported to the callback from the calling thread,
+    /// in the order of the GFA, after all chunks are done.
+    ///
+
+    const size_t links_per_job = 4096;
+
+    total_true_stats = {};
+    total_gfa_stats = {};
+
+    auto result = this->gfa_reader.line_indexes_by_type.find('L');
+
+    if (result == this->gfa_reader.line_indexes_by_type.end()){
+        return;
+    }
+
+    auto& link_lines = result->second;
+    size_t n_jobs = (link_lines.size() + links_per_job - 1) / links_per_job;
+
+    vector <vector <OverlapValidation> > invalid_links_per_job(n_jobs);
+    vector <CigarStats> true_stats_per_job(n_jobs);
+    vector <CigarStats> gfa_stats_per_job(n_jobs);
+
+    run_jobs_in_parallel(n_jobs, this->n_threads, [&](size_t j){
+        OverlapValidation validation;
+        size_t stop = std::min(link_lines.size(), (j+1)*links_per_job);
+
+        for (size_t i=j*links_per_job; i<stop; i++){
+            this->validate_link(link_lines[i], validation);
+
+            true_stats_per_job[j] += validation.true_stats;
+            gfa_stats_per_job[j] += validation.gfa_stats;
+
+            if (not validation.is_valid()){
+                invalid_links_per_job[j].emplace_back(std::move(validation));
+            }
+        }
+    });
+
+    for (size_t j=0; j<n_jobs; j++){
+        total_true_stats += true_stats_per_job[j];
+        total_gfa_stats += gfa_stats_per_job[j];
+
+        for (auto& validation: invalid_links_per_job[j]){
+            on_invalid_link(validation);
+        }
+    }
+}
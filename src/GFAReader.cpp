@@ -1,29 +1,39 @@
-
 #include "GFAReader.hpp"
+#include "GFAIndexer.hpp"
 #include "BinaryIO.hpp"
+#include "Parallel.hpp"
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <algorithm>
+#include <limits>
+#include <queue>
+#include <tuple>
+#include <cstdlib>
+#include <charconv>
+#include <fcntl.h>
+#include <unistd.h>
 
-using std::stoi;
 using std::cout;
 using std::ofstream;
 using std::runtime_error;
+using std::priority_queue;
+using std::greater;
+using std::tuple;
+using std::lock_guard;
 
 
-const char GFAReader::EOF_CODE = 'X';
-
-GFAIndex::GFAIndex(char type, uint64_t offset){
-    this->type = type;
-    this->offset = offset;
-}
+const uint64_t GFAReader::READ_COALESCE_GAP = 64*1024;
+const uint64_t GFAReader::READ_BLOCK_SIZE = 8*1024*1024;
+const uint64_t GFAReader::NO_LIMIT = std::numeric_limits<uint64_t>::max();
 
 
-GFAReader::GFAReader(path gfa_path){
+GFAReader::GFAReader(path gfa_path, size_t n_threads, bool compress_offsets){
     this->gfa_path = gfa_path;
     this->gfa_index_path = gfa_path;
     this->gfa_index_path.replace_extension("gfai");
     this->gfa_file_descriptor = -1;
+    this->n_threads = std::max(size_t(1), n_threads);
 
     // Test file
     ifstream test_stream(this->gfa_path);
@@ -31,143 +41,325 @@ GFAReader::GFAReader(path gfa_path){
         throw runtime_error("ERROR: file could not be opened: " + this->gfa_path.string());
     }
 
+    GFAIndexer indexer(this->gfa_path, this->gfa_index_path, this->n_threads, compress_offsets);
+
     // Check if index exists, and generate one if necessary
     if (!exists(this->gfa_index_path)) {
         cerr << "No index found, generating .gfai for " << this->gfa_path << " ... ";
 
-        this->index();
+        indexer.index();
         cerr << "done\n";
     }
     // If index is found, load it
     else{
         cerr << "Found index, loading from disk: " << this->gfa_index_path << " ... ";
 
-        this->read_index();
+        GFAIndexStatus status;
+
+        // Unreadable, outdated or mismatched indexes are never trusted, they are rebuilt from the GFA
+        try {
+            this->read_index();
+            status = indexer.check_index_status(*this);
+        }
+        catch (runtime_error& e){
+            cerr << e.what() << '\n';
+            status = INDEX_STALE;
+        }
+
+        if (status == INDEX_APPENDED){
+            cerr << "GFA has grown since it was indexed, extending index ... ";
+            indexer.extend_index(*this);
+        }
+        else if (status == INDEX_STALE){
+            cerr << "Index does not match GFA, regenerating .gfai for " << this->gfa_path << " ... ";
+            indexer.index();
+        }
+
         cerr << "done\n";
     }
+
+    // Serve queries from the file on disk, whether it was just written or already there
+    this->read_index();
+
+    // Opened once, so that const queries never have to modify the reader
+    this->gfa_file_descriptor = ::open(this->gfa_path.c_str(), O_RDONLY);
+
+    if (this->gfa_file_descriptor == -1){
+        throw runtime_error("ERROR: file could not be opened: " + this->gfa_path.string());
+    }
 }
 
 
 GFAReader::~GFAReader(){
-    if (fcntl(this->gfa_file_descriptor, F_GETFD)){
+    if (this->gfa_file_descriptor != -1){
         ::close(this->gfa_file_descriptor);
     }
 }
 
 
 void GFAReader::read_index(){
-    // Open the input file.
-    int file_descriptor = ::open(this->gfa_index_path.c_str(), O_RDONLY);
+    ///
+    /// Map the index into memory and use its columns in place, without parsing or copying any entries
+    ///
+
+    this->index_file = std::make_unique<MappedIndexFile>(this->gfa_index_path, GFAIndexer::INDEX_MAGIC, GFAIndexer::INDEX_VERSION);
 
-    // Verify it is working
-    if(file_descriptor == -1) {
-        throw runtime_error("ERROR: could not read " + this->gfa_index_path.string());
+    auto& file = *this->index_file;
+
+    this->line_offsets.types = file.get_section<char>(LINE_TYPES);
+
+    if (file.has_section(LINE_OFFSETS_COMPRESSED)){
+        EliasFano offsets;
+        offsets.load(file.get_section<uint64_t>(LINE_OFFSETS_COMPRESSED));
+        this->line_offsets.offsets = offsets;
+    }
+    else{
+        this->line_offsets.offsets = file.get_section<uint64_t>(LINE_OFFSETS);
     }
 
-    // Find file size in bytes, calculate number of entries in file
-    off_t file_length = lseek(file_descriptor, 0, SEEK_END);
-    off_t n_entries = file_length / (sizeof(uint64_t) + sizeof(char));
+    if (this->line_offsets.types.size() != this->line_offsets.offsets.size()){
+        throw runtime_error("ERROR: index columns have inconsistent lengths: " + this->gfa_index_path.string());
+    }
 
-    // Initialize index to track position in file (AKA cursor)
-    off_t byte_index = 0;
+    auto type_codes = file.get_section<char>(TYPE_CODES);
+    auto type_line_bounds = file.get_section<uint64_t>(TYPE_LINE_BOUNDS);
+    this->line_indexes_by_type.clear();
 
-    // Read all the chunks and add them to the index data structures
-    for (off_t i = 0; i < n_entries; i++){
-        char c;
-        uint64_t offset;
+    if (file.has_section(TYPE_LINES_COMPRESSED)){
+        auto type_lines = file.get_section<uint64_t>(TYPE_LINES_COMPRESSED);
+        auto bounds = file.get_section<uint64_t>(TYPE_LINES_COMPRESSED_BOUNDS);
 
-        pread_value_from_binary(file_descriptor,  c, byte_index);
-        pread_value_from_binary(file_descriptor,  offset, byte_index);
+        for (size_t i=0; i<type_codes.size(); i++){
+            EliasFano lines;
+            lines.load({type_lines.data() + bounds.at(i), bounds.at(i+1) - bounds[i]});
 
-        this->line_offsets.emplace_back(c, offset);
-        this->line_indexes_by_type[c].emplace_back(this->line_offsets.size() - 1);
+            if (lines.size() != type_line_bounds[i+1] - type_line_bounds[i]){
+                throw runtime_error("ERROR: compressed line lists do not match their bounds in index: " + this->gfa_index_path.string());
+            }
+
+            this->line_indexes_by_type[type_codes[i]] = lines;
+        }
+    }
+    else{
+        auto type_lines = file.get_section<uint64_t>(TYPE_LINES);
+
+        for (size_t i=0; i<type_codes.size(); i++){
+            auto start = type_line_bounds[i];
+            auto stop = type_line_bounds[i+1];
+            this->line_indexes_by_type[type_codes[i]] = ArrayView<uint64_t>(type_lines.data() + start, stop - start);
+        }
+    }
+
+    this->node_table.names = file.get_section<char>(NODE_NAMES);
+    this->node_table.name_bounds = file.get_section<uint64_t>(NODE_NAME_BOUNDS);
+    this->node_table.sequence_lines = file.get_section<uint64_t>(NODE_SEQUENCE_LINES);
+    this->node_table.link_bounds = file.get_section<uint64_t>(NODE_LINK_BOUNDS);
+    this->node_table.link_lines = file.get_section<uint64_t>(NODE_LINK_LINES);
+    this->node_table.id_offset = file.get_section<int64_t>(NODE_ID_OFFSET);
+    this->node_table.handles_by_id = file.get_section<NodeHandle>(NODE_HANDLES_BY_ID);
+
+    this->adjacency_bounds = file.get_section<uint64_t>(ADJACENCY_BOUNDS);
+    this->adjacency_edges = file.get_section<GFAEdge>(ADJACENCY_EDGES);
+    this->sequence_lengths = file.get_section<uint64_t>(SEQUENCE_LENGTHS);
+
+    if (this->adjacency_bounds.size() != this->node_table.size() + 1 or this->sequence_lengths.size() != this->node_table.size()){
+        throw runtime_error("ERROR: node columns do not match node table in index: " + this->gfa_index_path.string());
     }
 
-    ::close(file_descriptor);
+    // The block table is only stored for compressed GFAs
+    this->bgzf_reader.reset();
+
+    if (file.has_section(BGZF_COMPRESSED_OFFSETS)){
+        this->bgzf_reader = std::make_unique<BGZFReader>(this->gfa_path);
+        this->bgzf_reader->load_blocks(file.get_section<uint64_t>(BGZF_COMPRESSED_OFFSETS), file.get_section<uint64_t>(BGZF_UNCOMPRESSED_OFFSETS));
+    }
+}
+
+
+void GFAReader::read_bytes(string& s, uint64_t offset, uint64_t length) const{
+    s.resize(length);
+    this->read_bytes(s.data(), offset, length);
 }
 
 
-void GFAReader::write_index_to_binary_file(){
-    ofstream index_file(this->gfa_index_path);
+void GFAReader::read_bytes(char* destination, uint64_t offset, uint64_t length) const{
+    ///
+    /// Read a range of the GFA text, decompressing it if the GFA is BGZF compressed
+    ///
 
-    for (auto& item: this->line_offsets){
-        // Write a pair, denoting the line type and the byte offset for the start of that line
-        write_value_to_binary(index_file, item.type);
-        write_value_to_binary(index_file, item.offset);
+    if (this->bgzf_reader){
+        this->bgzf_reader->read(offset, length, destination);
+    }
+    else{
+        off_t file_offset = offset;
+        pread_bytes(this->gfa_file_descriptor, destination, length, file_offset);
     }
 }
 
 
-void GFAReader::index() {
-    ifstream gfa_file(this->gfa_path);
-    uint64_t byte_offset = 0;
-    bool newline = true;
-    char gfa_type_code;
-    char c;
+void GFAReader::read_line(string& s, size_t index) const{
+    uint64_t offset_start = this->line_offsets[index].offset;
+    uint64_t offset_stop = this->line_offsets[index+1].offset;
 
-    // Find all the newlines in the GFA and store each line's byte offset in a vector. Additionally build a map which
-    // lists all the positions in the index vector for each line type (e.g. S,L,H,U, etc.), so they can be iterated even
-    // if they are not grouped or in order (which is not required by the GFA format spec)
-    while (gfa_file.get(c)){
-        if (c == '\n'){
-            newline = true;
-        }
-        else{
-            if (newline) {
-                gfa_type_code = c;
-                this->line_offsets.emplace_back(gfa_type_code, byte_offset);
-                this->line_indexes_by_type[gfa_type_code].emplace_back(this->line_offsets.size() - 1);
-                newline = false;
+    this->read_bytes(s, offset_start, offset_stop - offset_start);
+}
+
+
+uint64_t GFAReader::get_line_virtual_offset(size_t index) const{
+    ///
+    /// BGZF virtual offset of the start of a line, or its byte offset if the GFA is not compressed
+    ///
+
+    auto offset = this->line_offsets.offsets.at(index);
+
+    if (this->bgzf_reader){
+        return this->bgzf_reader->get_virtual_offset(offset);
+    }
+
+    return offset;
+}
+
+
+string_view strip_folded_lines(string_view line){
+    ///
+    /// Blank lines that follow a line are part of its index entry, keep only the line itself and its newline
+    ///
+
+    auto newline = line.find('\n');
+
+    if (newline == string_view::npos){
+        return line;
+    }
+
+    return line.substr(0, newline + 1);
+}
+
+
+void GFAReader::plan_line_reads(const vector <uint64_t>& line_indexes, vector <GFAReadRange>& ranges) const{
+    ///
+    /// Group sorted and unique line indexes into reads. Consecutive lines separated by less than READ_COALESCE_GAP
+    /// bytes are fetched with a single read spanning all of them (up to READ_BLOCK_SIZE), so that the number of reads
+    /// depends on how the lines are laid out, not on how many there are.
+    ///
+
+    auto& offsets = this->line_offsets.offsets;
+    ranges.clear();
+    size_t i = 0;
+
+    while (i < line_indexes.size()){
+        GFAReadRange range = {offsets.at(line_indexes[i]), offsets.at(line_indexes[i] + 1), i, i + 1};
+
+        for (; range.last<line_indexes.size(); range.last++){
+            auto j = range.last;
+
+            if (line_indexes[j] <= line_indexes[j-1]){
+                throw runtime_error("ERROR: line indexes are not sorted and unique: " + std::to_string(line_indexes[j]));
+            }
+
+            auto start = offsets.at(line_indexes[j]);
+            auto stop = offsets.at(line_indexes[j] + 1);
+
+            if (start - range.stop > READ_COALESCE_GAP or stop - range.start > READ_BLOCK_SIZE){
+                break;
             }
+
+            range.stop = stop;
         }
-        byte_offset++;
+
+        ranges.emplace_back(range);
+        i = range.last;
     }
+}
+
+
+void GFAReader::for_each_line(const vector <uint64_t>& line_indexes, const function<void(uint64_t line_index, string_view line)>& f) const{
+    ///
+    /// Read many lines, given as sorted and unique line indexes, and visit them in file order, one coalesced read at a
+    /// time (see plan_line_reads), so that memory use is bounded by READ_BLOCK_SIZE however many lines there are
+    ///
 
-    // Append a placeholder to tell the total length of the file
-    this->line_offsets.emplace_back(this->EOF_CODE, byte_offset);
-    this->write_index_to_binary_file();
+    auto& offsets = this->line_offsets.offsets;
+    vector <GFAReadRange> ranges;
+    string block;
+
+    this->plan_line_reads(line_indexes, ranges);
+
+    for (auto& range: ranges){
+        this->read_bytes(block, range.start, range.stop - range.start);
+
+        string_view block_view(block);
+        for (size_t k=range.first; k<range.last; k++){
+            auto start = offsets[line_indexes[k]];
+            auto stop = offsets[line_indexes[k] + 1];
+            f(line_indexes[k], block_view.substr(start - range.start, stop - start));
+        }
+    }
 }
 
 
-void GFAReader::read_line(string& s, size_t index){
-    if (this->gfa_file_descriptor == -1){
-        this->gfa_file_descriptor = ::open(this->gfa_path.c_str(), O_RDONLY);
+void GFAReader::read_lines(const vector <uint64_t>& line_indexes, GFALineBatch& batch) const{
+    ///
+    /// Fetch any number of lines, in any order and with repeats, into one arena. The distinct lines are sorted and
+    /// coalesced into reads (see plan_line_reads), the arena is sized once for all of them, and the reads are issued
+    /// in parallel, each directly into its own part of the arena. Views are then handed back in request order.
+    ///
+
+    auto& offsets = this->line_offsets.offsets;
+
+    vector <uint64_t> sorted_lines(line_indexes);
+    std::sort(sorted_lines.begin(), sorted_lines.end());
+    sorted_lines.erase(std::unique(sorted_lines.begin(), sorted_lines.end()), sorted_lines.end());
+
+    vector <GFAReadRange> ranges;
+    this->plan_line_reads(sorted_lines, ranges);
+
+    vector <uint64_t> arena_offsets(ranges.size() + 1, 0);
+    for (size_t r=0; r<ranges.size(); r++){
+        arena_offsets[r+1] = arena_offsets[r] + (ranges[r].stop - ranges[r].start);
     }
 
-    off_t offset_start = this->line_offsets[index].offset;
-    off_t offset_stop = this->line_offsets[index+1].offset;
-    off_t length = offset_stop - offset_start;
+    batch.arena.resize(arena_offsets.back());
+    batch.n_reads = ranges.size();
+
+    run_jobs_in_parallel(ranges.size(), this->n_threads, [&](size_t r){
+        this->read_bytes(batch.arena.data() + arena_offsets[r], ranges[r].start, ranges[r].stop - ranges[r].start);
+    });
 
-    pread_string_from_binary(this->gfa_file_descriptor, s, length, offset_start);
+    // Position of every distinct line in the arena
+    vector <string_view> sorted_views(sorted_lines.size());
+    string_view arena(batch.arena);
+
+    for (size_t r=0; r<ranges.size(); r++){
+        for (size_t k=ranges[r].first; k<ranges[r].last; k++){
+            auto start = offsets[sorted_lines[k]];
+            auto stop = offsets[sorted_lines[k] + 1];
+            sorted_views[k] = strip_folded_lines(arena.substr(arena_offsets[r] + start - ranges[r].start, stop - start));
+        }
+    }
+
+    batch.lines.resize(line_indexes.size());
+    for (size_t i=0; i<line_indexes.size(); i++){
+        auto k = std::lower_bound(sorted_lines.begin(), sorted_lines.end(), line_indexes[i]) - sorted_lines.begin();
+        batch.lines[i] = sorted_views[k];
+    }
 }
 
 
 void GFAReader::map_sequences_by_node(){
-    cerr << "Mapping GFA S lines to node names... ";
+    ///
+    /// Fill the name -> S line map from the node table stored in the index, without reading the GFA
+    ///
 
-    ifstream gfa_file(this->gfa_path);
-    string token;
-    char c = 0;
+    cerr << "Mapping GFA S lines to node names... ";
 
-    // For every sequence line that has been indexed, jump to their offset in the file and read just the node names
-    for (size_t i=0; i<this->line_indexes_by_type.at('S').size(); i++){
-        auto line_index = this->line_indexes_by_type.at('S')[i];
-        auto offset_start = this->line_offsets[line_index].offset + 2;  // Skip the line type character and tab
-        token.resize(0);
+    this->sequence_line_indexes_by_node.reserve(this->node_table.size());
 
-        gfa_file.seekg(offset_start);
+    for (NodeHandle i=0; i<this->node_table.size(); i++){
+        auto line_index = this->node_table.sequence_lines[i];
 
-        // Parse the node name
-        while (gfa_file.get(c)){
-            if (c == '\t'){
-                break;
-            }
-            token += c;
+        if (line_index != GFANodeTable::NO_LINE){
+            this->sequence_line_indexes_by_node[string(this->node_table.get_name(i))] = line_index;
         }
-
-        // Create the mapping that tells where in the file to find each node's sequence data
-        this->sequence_line_indexes_by_node[token] = line_index;
-        c = 0;
     }
 
     cerr << "done\n";
@@ -175,141 +367,720 @@ void GFAReader::map_sequences_by_node(){
 
 
 void GFAReader::map_links_by_node(){
+    ///
+    /// Fill the name -> L lines map from the node table stored in the index, without reading the GFA
+    ///
+
     cerr << "Mapping GFA L lines to node names... ";
 
-    ifstream gfa_file(this->gfa_path);
-    string token;
-    uint64_t n_separators = 0;
-    char c = 0;
-
-    // For every link line that has been indexed, jump to their offset in the file and read just the node names
-    for (size_t i=0; i<this->line_indexes_by_type.at('L').size(); i++){
-        auto line_index = this->line_indexes_by_type.at('L')[i];
-        auto offset_start = this->line_offsets[line_index].offset + 2;  // Skip the line type character and tab
-        token.resize(0);
-        n_separators = 0;
-
-        gfa_file.seekg(offset_start);
-
-        // Parse the node name
-        while (gfa_file.get(c)){
-            if (c == '\t'){
-                if (n_separators == 0){
-                    // Create the mapping that tells where in the file to find each node's link data
-                    this->link_line_indexes_by_node[token].insert(line_index);
+    for (NodeHandle i=0; i<this->node_table.size(); i++){
+        auto link_lines = this->node_table.get_link_lines(i);
+
+        if (not link_lines.empty()){
+            this->link_line_indexes_by_node[string(this->node_table.get_name(i))].insert(link_lines.begin(), link_lines.end());
+        }
+    }
+
+    cerr << "done\n";
+}
+
+
+size_t GFAReader::get_node_count() const{
+    return this->node_table.size();
+}
+
+
+bool GFAReader::find_node_handle(string_view node_name, NodeHandle& handle) const{
+    return this->node_table.find(node_name, handle);
+}
+
+
+bool GFAReader::find_node_handle(int64_t node_id, NodeHandle& handle) const{
+    return this->node_table.find(node_id, handle);
+}
+
+
+NodeHandle GFAReader::get_node_handle(string_view node_name) const{
+    NodeHandle handle;
+
+    if (not this->node_table.find(node_name, handle)){
+        throw runtime_error("ERROR: node not found in GFA: " + string(node_name));
+    }
+
+    return handle;
+}
+
+
+NodeHandle GFAReader::get_node_handle(int64_t node_id) const{
+    NodeHandle handle;
+
+    if (not this->node_table.find(node_id, handle)){
+        throw runtime_error("ERROR: node not found in GFA: " + std::to_string(node_id));
+    }
+
+    return handle;
+}
+
+
+string_view GFAReader::get_node_name(NodeHandle handle) const{
+    return this->node_table.get_name(handle);
+}
+
+
+uint64_t GFAReader::get_sequence_line_index(NodeHandle handle) const{
+    auto line_index = this->node_table.sequence_lines.at(handle);
+
+    if (line_index == GFANodeTable::NO_LINE){
+        throw runtime_error("ERROR: node has no S line in GFA: " + string(this->node_table.get_name(handle)));
+    }
+
+    return line_index;
+}
+
+
+ArrayView<uint64_t> GFAReader::get_link_line_indexes(NodeHandle handle) const{
+    return this->node_table.get_link_lines(handle);
+}
+
+
+ArrayView<GFAEdge> GFAReader::get_edges(NodeHandle handle) const{
+    auto start = this->adjacency_bounds.at(handle);
+    auto stop = this->adjacency_bounds[handle + 1];
+    return {this->adjacency_edges.data() + start, stop - start};
+}
+
+
+void GFAReader::for_each_neighbor(NodeHandle handle, bool reversed, const function<void(const GFAEdge& edge)>& f) const{
+    ///
+    /// Visit the edges that leave this node when it is traversed in the given orientation. To walk the graph, follow
+    /// edge.neighbor and continue from it in orientation edge.neighbor_reversed.
+    ///
+
+    for (auto& edge: this->get_edges(handle)){
+        if (bool(edge.reversed) == reversed){
+            f(edge);
+        }
+    }
+}
+
+
+void GFAReader::get_neighborhood(const vector <NodeHandle>& seeds, uint64_t max_hops, uint64_t max_distance, vector <NodeHandle>& neighborhood) const{
+    ///
+    /// Find every node within `max_hops` links and `max_distance` bp of any seed, following links in both directions.
+    /// The distance of a node is the total length of the nodes between it and the seed, so the neighbors of a seed are
+    /// at distance 0. Overlaps are not subtracted. Nodes are settled in order of distance (Dijkstra), or in order of
+    /// hops when there is no distance limit. When both limits are given, the shortest path in bp may use up the hop
+    /// budget before a longer path with fewer hops does, so a node is expanded again whenever it is reached with fewer
+    /// hops than any earlier visit. Only visited nodes are stored, so the cost depends on the size of the neighborhood
+    /// and not of the graph. Either limit may be NO_LIMIT. The result is sorted.
+    ///
+
+    // (primary key, secondary key, handle), with keys (distance, hops) or (hops, distance)
+    typedef tuple <uint64_t, uint64_t, NodeHandle> queue_entry;
+
+    bool by_hops = (max_distance == NO_LIMIT);
+    priority_queue <queue_entry, vector <queue_entry>, greater <queue_entry> > queue;
+
+    // Fewest hops with which each node has been expanded. Entries are popped in order of distance (or hops), so a
+    // later visit is only worth expanding if it has fewer hops, and only if hops are limited at all.
+    unordered_map <NodeHandle, uint64_t> visited_hops;
+
+    auto is_dominated = [&](NodeHandle handle, uint64_t hops){
+        auto result = visited_hops.find(handle);
+        return result != visited_hops.end() and (max_hops == NO_LIMIT or result->second <= hops);
+    };
+
+    for (auto& seed: seeds){
+        if (seed >= this->get_node_count()){
+            throw runtime_error("ERROR: node handle out of range: " + std::to_string(seed));
+        }
+        queue.emplace(0, 0, seed);
+    }
+
+    neighborhood.clear();
+
+    while (not queue.empty()){
+        auto [primary, secondary, handle] = queue.top();
+        queue.pop();
+
+        uint64_t hops = by_hops ? primary : secondary;
+        uint64_t distance = by_hops ? secondary : primary;
+
+        if (is_dominated(handle, hops)){
+            continue;
+        }
+
+        // Nodes that are expanded again are only reported once
+        auto [iter, is_new] = visited_hops.try_emplace(handle, hops);
+        if (is_new){
+            neighborhood.emplace_back(handle);
+        }
+        else{
+            iter->second = hops;
+        }
+
+        // Seeds do not count towards the distance of their neighbors
+        uint64_t next_hops = hops + 1;
+        uint64_t next_distance = distance + ((hops == 0) ? 0 : this->sequence_lengths[handle]);
+
+        if (next_hops > max_hops or next_distance > max_distance){
+            continue;
+        }
+
+        for (auto& edge: this->get_edges(handle)){
+            if (not is_dominated(edge.neighbor, next_hops)){
+                if (by_hops){
+                    queue.emplace(next_hops, next_distance, edge.neighbor);
                 }
-                else if (n_separators == 2){
-                    // Create the mapping that tells where in the file to find each node's link data
-                    this->link_line_indexes_by_node[token].insert(line_index);
-                    break;
+                else{
+                    queue.emplace(next_distance, next_hops, edge.neighbor);
                 }
-                token.resize(0);
-                n_separators++;
-            }
-            else {
-                token += c;
             }
         }
+    }
 
-        c = 0;
+    std::sort(neighborhood.begin(), neighborhood.end());
+}
+
+
+void GFAReader::write_link_subset_to_file(const unordered_set<string>& node_subset, ofstream& output_file) const{
+    vector <NodeHandle> handles;
+    NodeHandle handle;
+
+    // Names that are not in the graph cannot be part of any link, so they are simply dropped
+    for (auto& name: node_subset){
+        if (this->find_node_handle(name, handle)){
+            handles.emplace_back(handle);
+        }
     }
 
-    cerr << "done\n";
+    this->write_link_subset_to_file(handles, output_file);
 }
 
 
-void GFAReader::write_link_subset_to_file(unordered_set<string>& node_subset, ofstream& output_file){
+void GFAReader::write_link_subset_to_file(const vector <NodeHandle>& node_subset, ofstream& output_file) const{
+    ///
+    /// Write every L line whose two nodes are both in the subset, in file order. The lines are found through the
+    /// adjacency of the subset's nodes, so the cost depends on the size of the subgraph and not of the whole graph.
+    ///
+
     cerr << "Writing GFA L lines to file... ";
 
-    ifstream gfa_file(this->gfa_path);
-    uint64_t n_separators = 0;
-    bool found_a = false;
-    bool found_b = false;
-    string token;
-    string line;
-    char c = 0;
-
-    // For every link line that has been indexed, jump to their offset in the file and read just the node names
-    for (size_t i=0; i<this->line_indexes_by_type.at('L').size(); i++){
-        auto line_index = this->line_indexes_by_type.at('L')[i];
-        auto offset_start = this->line_offsets[line_index].offset;  // Skip the line type character and tab
-        token.resize(0);
-        n_separators = 0;
-        found_a = false;
-        found_b = false;
-
-        gfa_file.seekg(offset_start);
-
-        // Parse the node name
-        while (gfa_file.get(c)){
-            if (c == '\t'){
-                if (n_separators == 1){
-                    found_a = (node_subset.count(token) != 0);
-                }
-                else if (n_separators == 3){
-                    found_b = (node_subset.count(token) != 0);
-                }
-                token.resize(0);
-                n_separators++;
-            }
-            else {
-                token += c;
+    vector <NodeHandle> subset(node_subset);
+    std::sort(subset.begin(), subset.end());
+    subset.erase(std::unique(subset.begin(), subset.end()), subset.end());
+
+    // Every L line appears in the adjacency of both of its nodes, so it is enough to look from one side
+    vector <uint64_t> link_lines;
+    for (auto& handle: subset){
+        for (auto& edge: this->get_edges(handle)){
+            if (std::binary_search(subset.begin(), subset.end(), edge.neighbor)){
+                link_lines.emplace_back(edge.line_index);
             }
-            line += c;
+        }
+    }
 
-            if (c == '\n'){
-                break;
+    std::sort(link_lines.begin(), link_lines.end());
+    link_lines.erase(std::unique(link_lines.begin(), link_lines.end()), link_lines.end());
+
+    this->for_each_line(link_lines, [&](uint64_t line_index, string_view line){
+        output_file << strip_folded_lines(line);
+    });
+
+    cerr << "done\n";
+}
+
+
+void GFAReader::write_subgraph_to_file(const unordered_set <string>& nodes, ofstream& output_gfa) const{
+    vector <NodeHandle> handles;
+
+    for (auto& node_name: nodes){
+        handles.emplace_back(this->get_node_handle(node_name));
+    }
+
+    this->write_subgraph_to_file(handles, output_gfa);
+}
+
+
+void GFAReader::write_subgraph_to_file(const vector <NodeHandle>& nodes, ofstream& output_gfa) const{
+    ///
+    /// Write the S lines of the nodes followed by the L lines between them, each group in file order
+    ///
+
+    vector <uint64_t> sequence_lines;
+    for (auto& handle: nodes){
+        sequence_lines.emplace_back(this->get_sequence_line_index(handle));
+    }
+
+    std::sort(sequence_lines.begin(), sequence_lines.end());
+    sequence_lines.erase(std::unique(sequence_lines.begin(), sequence_lines.end()), sequence_lines.end());
+
+    this->for_each_line(sequence_lines, [&](uint64_t line_index, string_view line){
+        output_gfa << strip_folded_lines(line);
+    });
+
+    this->write_link_subset_to_file(nodes, output_gfa);
+}
+
+
+void GFAReader::write_subgraphs_to_files(const vector <vector <NodeHandle> >& node_sets, const vector <path>& output_paths) const{
+    ///
+    /// Write many subgraphs at once, each one formatted as by write_subgraph_to_file(). Every (line, output) pair
+    /// is listed up front and sorted by line, so the GFA is read in one ordered pass over the requested S lines and
+    /// one over the requested L lines, and each line that is read is copied to every output that contains it. Output
+    /// is buffered per subgraph, so only one output file is open at any time.
+    ///
+
+    if (node_sets.size() != output_paths.size()){
+        throw runtime_error("ERROR: number of node sets does not match number of output paths");
+    }
+
+    const size_t output_buffer_size = 1024*1024;
+
+    vector <pair <uint64_t, size_t> > sequence_routes;
+    vector <pair <uint64_t, size_t> > link_routes;
+
+    for (size_t i=0; i<node_sets.size(); i++){
+        vector <NodeHandle> subset(node_sets[i]);
+        std::sort(subset.begin(), subset.end());
+        subset.erase(std::unique(subset.begin(), subset.end()), subset.end());
+
+        for (auto& handle: subset){
+            sequence_routes.emplace_back(this->get_sequence_line_index(handle), i);
+
+            for (auto& edge: this->get_edges(handle)){
+                if (std::binary_search(subset.begin(), subset.end(), edge.neighbor)){
+                    link_routes.emplace_back(edge.line_index, i);
+                }
             }
         }
+    }
+
+    vector <string> buffers(node_sets.size());
+    vector <bool> is_started(node_sets.size(), false);
+
+    // The first write to an output replaces any existing file, later writes append to it
+    auto flush = [&](size_t i){
+        ofstream output_file(output_paths[i], is_started[i] ? std::ios::app : std::ios::trunc);
+
+        if (not output_file.is_open()){
+            throw runtime_error("ERROR: could not write file: " + output_paths[i].string());
+        }
+
+        output_file << buffers[i];
+        buffers[i].clear();
+        is_started[i] = true;
+    };
+
+    auto route_lines = [&](vector <pair <uint64_t, size_t> >& routes){
+        std::sort(routes.begin(), routes.end());
+        routes.erase(std::unique(routes.begin(), routes.end()), routes.end());
 
-        if (found_a and found_b){
-            output_file << line;
+        vector <uint64_t> line_indexes;
+        for (auto& [line_index, i]: routes){
+            if (line_indexes.empty() or line_indexes.back() != line_index){
+                line_indexes.emplace_back(line_index);
+            }
         }
 
-        line.resize(0);
-        c = 0;
+        size_t r = 0;
+        this->for_each_line(line_indexes, [&](uint64_t line_index, string_view line){
+            line = strip_folded_lines(line);
+
+            for (; r < routes.size() and routes[r].first == line_index; r++){
+                auto i = routes[r].second;
+                buffers[i] += line;
+
+                if (buffers[i].size() > output_buffer_size){
+                    flush(i);
+                }
+            }
+        });
+    };
+
+    cerr << "Writing " << node_sets.size() << " subgraphs to file... ";
+
+    route_lines(sequence_routes);
+    route_lines(link_routes);
+
+    // Every output is created, even if its subgraph is empty
+    for (size_t i=0; i<node_sets.size(); i++){
+        flush(i);
     }
 
     cerr << "done\n";
 }
 
 
-void GFAReader::write_subgraph_to_file(unordered_set <string>& nodes, ofstream& output_gfa){
-    string gfa_line;
-    for (auto& node_name: nodes){
-        this->read_line(gfa_line, this->sequence_line_indexes_by_node.at(node_name));
-        output_gfa << gfa_line;
+uint64_t GFAReader::get_sequence_length(string node_name) const{
+    return this->get_sequence_length(this->get_node_handle(node_name));
+}
+
+
+uint64_t GFAReader::get_sequence_length(NodeHandle handle) const{
+    ///
+    /// Length of a segment, as computed once during indexing, see parse_sequence_length()
+    ///
+
+    if (this->node_table.sequence_lines.at(handle) == GFANodeTable::NO_LINE){
+        throw runtime_error("ERROR: node has no S line in GFA: " + string(this->node_table.get_name(handle)));
     }
 
-    this->write_link_subset_to_file(nodes, output_gfa);
+    return this->sequence_lengths[handle];
+}
+
+
+void GFAReader::get_sequence_lengths(const vector <NodeHandle>& handles, vector <uint64_t>& lengths) const{
+    lengths.resize(handles.size());
+
+    for (size_t i=0; i<handles.size(); i++){
+        lengths[i] = this->get_sequence_length(handles[i]);
+    }
 }
 
 
-uint64_t GFAReader::get_sequence_length(string node_name){
-    auto vector_index = this->sequence_line_indexes_by_node.at(node_name);
-    auto start_index = this->line_offsets[vector_index].offset;
+size_t get_first_tag_field(char line_type){
+    ///
+    /// Number of required fields of each GFA1 line type, after which the optional tags start
+    ///
+
+    switch (line_type){
+        case 'S': return 3;
+        case 'L': return 6;
+        case 'C': return 7;
+        case 'P': return 4;
+        case 'W': return 7;
+        default: return 1;
+    }
+}
+
+
+void GFAReader::extract_tag_column(char line_type, string_view tag, char tag_type, GFATagColumnBuffers& buffers) const{
+    ///
+    /// Parse one tag out of every line of a type. Columns of S lines are indexed by NodeHandle, so that they line up
+    /// with the node table and sequence lengths. Columns of other types follow the order of line_indexes_by_type.
+    /// Lines are read in sorted chunks with for_each_line, and chunks are parsed in parallel, each filling its own
+    /// slots of the column.
+    ///
+
+    const size_t lines_per_job = 16384;
+
+    // (line index, slot in column), sorted by line so that every chunk is one forward sweep of the GFA
+    vector <pair <uint64_t, size_t> > lines;
+    size_t n_slots = 0;
+
+    if (line_type == 'S'){
+        n_slots = this->node_table.size();
 
-    char c;
-    uint64_t length = 0;
-    uint64_t n_separators = 0;
-    ifstream file(this->gfa_path);
+        for (NodeHandle h=0; h<n_slots; h++){
+            if (this->node_table.sequence_lines[h] != GFANodeTable::NO_LINE){
+                lines.emplace_back(this->node_table.sequence_lines[h], h);
+            }
+        }
+
+        std::sort(lines.begin(), lines.end());
+    }
+    else{
+        auto result = this->line_indexes_by_type.find(line_type);
 
-    file.seekg(start_index);
+        if (result != this->line_indexes_by_type.end()){
+            n_slots = result->second.size();
 
-    // Count only characters in the sequence (not before or after)
-    while(file.get(c)) {
-        if (c == '\t' or c == '\n') {
-            n_separators++;
-        } else {
-            if (n_separators == 2) {
-                length++;
+            for (size_t i=0; i<n_slots; i++){
+                lines.emplace_back(result->second[i], i);
             }
-            else if (n_separators > 2){
+        }
+    }
+
+    bool is_numeric = GFATagColumn::is_numeric(tag_type);
+
+    buffers = {};
+    buffers.present.resize(n_slots, 0);
+
+    if (tag_type == 'i'){
+        buffers.integers.resize(n_slots, 0);
+    }
+    else if (tag_type == 'f'){
+        buffers.floats.resize(n_slots, 0);
+    }
+
+    vector <string> string_values(is_numeric ? 0 : n_slots);
+    size_t n_jobs = (lines.size() + lines_per_job - 1) / lines_per_job;
+    auto first_tag_field = get_first_tag_field(line_type);
+
+    run_jobs_in_parallel(n_jobs, this->n_threads, [&](size_t j){
+        size_t start = j*lines_per_job;
+        size_t stop = std::min(lines.size(), start + lines_per_job);
+
+        vector <uint64_t> line_indexes;
+        for (size_t i=start; i<stop; i++){
+            line_indexes.emplace_back(lines[i].first);
+        }
+
+        vector <string_view> fields;
+        size_t i = start;
+
+        this->for_each_line(line_indexes, [&](uint64_t line_index, string_view line){
+            auto slot = lines[i++].second;
+
+            split_gfa_line(line, fields, std::numeric_limits<size_t>::max());
+
+            for (size_t f=first_tag_field; f<fields.size(); f++){
+                auto& field = fields[f];
+
+                if (field.size() < 5 or field[2] != ':' or field[4] != ':' or field.substr(0,2) != tag){
+                    continue;
+                }
+
+                if (field[3] != tag_type){
+                    throw runtime_error("ERROR: tag " + string(field.substr(0,4)) + " found at line " + std::to_string(line_index) + ", expected type " + tag_type);
+                }
+
+                auto value = field.substr(5);
+
+                if (tag_type == 'i'){
+                    auto result = std::from_chars(value.data(), value.data() + value.size(), buffers.integers[slot]);
+
+                    if (result.ec != std::errc() or result.ptr != value.data() + value.size()){
+                        throw runtime_error("ERROR: invalid integer tag " + string(field) + " at line " + std::to_string(line_index));
+                    }
+                }
+                else if (tag_type == 'f'){
+                    string s(value);
+                    char* end;
+                    buffers.floats[slot] = std::strtod(s.c_str(), &end);
+
+                    if (s.empty() or *end != '\0'){
+                        throw runtime_error("ERROR: invalid float tag " + string(field) + " at line " + std::to_string(line_index));
+                    }
+                }
+                else{
+                    string_values[slot] = value;
+                }
+
+                buffers.present[slot] = 1;
                 break;
             }
+        });
+    });
+
+    if (not is_numeric){
+        buffers.string_bounds.reserve(n_slots + 1);
+        buffers.string_bounds.emplace_back(0);
+
+        for (auto& value: string_values){
+            buffers.strings.insert(buffers.strings.end(), value.begin(), value.end());
+            buffers.string_bounds.emplace_back(buffers.strings.size());
         }
     }
+}
 
-    return length;
+
+const GFATagColumn& GFAReader::get_tag_column(char line_type, string_view tag, char tag_type) const{
+    ///
+    /// Typed column of one tag, e.g. get_tag_column('S', "RC", 'i') for the read coverage of every segment. Columns
+    /// are loaded on first use: from the index if a previous run already extracted them, otherwise by parsing the
+    /// GFA once, after which they are added to the .gfai for later runs. If the index can't be rewritten (e.g. it
+    /// is read-only), the column is only kept in memory. Safe to call concurrently, the first caller does the work.
+    ///
+
+    auto id = get_tag_column_section(line_type, tag, tag_type, TAG_PRESENT);
+
+    lock_guard<mutex> lock(this->lazy_section_mutex);
+
+    auto result = this->tag_columns.find(id);
+    if (result != this->tag_columns.end()){
+        return result->second;
+    }
+
+    GFATagColumn column;
+    column.line_type = line_type;
+    column.tag = tag;
+    column.tag_type = tag_type;
+
+    auto values_id = get_tag_column_section(line_type, tag, tag_type, TAG_VALUES);
+    auto bounds_id = get_tag_column_section(line_type, tag, tag_type, TAG_STRING_BOUNDS);
+    auto& file = *this->index_file;
+
+    if (file.has_section(id)){
+        column.present = file.get_section<uint8_t>(id);
+
+        if (tag_type == 'i'){
+            column.integers = file.get_section<int64_t>(values_id);
+        }
+        else if (tag_type == 'f'){
+            column.floats = file.get_section<double>(values_id);
+        }
+        else{
+            column.strings = file.get_section<char>(values_id);
+            column.string_bounds = file.get_section<uint64_t>(bounds_id);
+        }
+    }
+    else{
+        cerr << "Extracting GFA tag " << line_type << ' ' << tag << ':' << tag_type << " ... ";
+
+        auto& buffers = this->tag_column_buffers[id];
+        buffers = std::make_unique<GFATagColumnBuffers>();
+        this->extract_tag_column(line_type, tag, tag_type, *buffers);
+
+        column.present = {buffers->present.data(), buffers->present.size()};
+        column.integers = {buffers->integers.data(), buffers->integers.size()};
+        column.floats = {buffers->floats.data(), buffers->floats.size()};
+        column.strings = {buffers->strings.data(), buffers->strings.size()};
+        column.string_bounds = {buffers->string_bounds.data(), buffers->string_bounds.size()};
+
+        cerr << "done\n";
+
+        this->add_section(id, buffers->present);
+
+        if (tag_type == 'i'){
+            this->add_section(values_id, buffers->integers);
+        }
+        else if (tag_type == 'f'){
+            this->add_section(values_id, buffers->floats);
+        }
+        else{
+            this->add_section(values_id, buffers->strings);
+            this->add_section(bounds_id, buffers->string_bounds);
+        }
+
+        this->save_added_sections();
+    }
+
+    result = this->tag_columns.emplace(id, column).first;
+
+    return result->second;
 }
 
+
+void GFAReader::save_added_sections() const{
+    ///
+    /// Append the sections that this reader has added since the last save to the .gfai. The mapping of this reader
+    /// stays untouched, and the sections are still used from memory. If the index can't be written (e.g. it is
+    /// read-only), they are only kept in memory, and saving is tried again with the next added section. Called under
+    /// the lock.
+    ///
+
+    try {
+        GFAIndexer indexer(this->gfa_path, this->gfa_index_path, this->n_threads);
+        indexer.add_sections_to_index(*this);
+        this->added_sections.clear();
+    }
+    catch (runtime_error& e){
+        cerr << "WARNING: could not save to index: " << e.what() << '\n';
+    }
+}
+
+
+void GFAReader::build_sequence_store(PackedSequenceBuffers& buffers) const{
+    ///
+    /// Pack the sequence of every S line, in NodeHandle order. Chunks of handles are read and packed in parallel, each
+    /// into its own buffers starting at base 0, which are then concatenated. Nodes without an S line, or with an
+    /// omitted sequence ("*"), get an empty sequence.
+    ///
+
+    const size_t nodes_per_job = 16384;
+
+    auto n_nodes = this->node_table.size();
+    size_t n_jobs = (n_nodes + nodes_per_job - 1) / nodes_per_job;
+    vector <PackedSequenceBuffers> buffers_per_job(n_jobs);
+
+    run_jobs_in_parallel(n_jobs, this->n_threads, [&](size_t j){
+        NodeHandle start = NodeHandle(j*nodes_per_job);
+        NodeHandle stop = NodeHandle(std::min(n_nodes, (j+1)*nodes_per_job));
+
+        // Handles are in name order, so their lines are sorted before reading, and packed in handle order after
+        vector <pair <uint64_t, NodeHandle> > lines;
+        for (NodeHandle h=start; h<stop; h++){
+            if (this->node_table.sequence_lines[h] != GFANodeTable::NO_LINE){
+                lines.emplace_back(this->node_table.sequence_lines[h], h);
+            }
+        }
+        std::sort(lines.begin(), lines.end());
+
+        vector <uint64_t> line_indexes;
+        for (auto& [line_index, h]: lines){
+            line_indexes.emplace_back(line_index);
+        }
+
+        // The serial for_each_line, since the jobs already use all the threads
+        vector <string> sequences(stop - start);
+        vector <string_view> fields;
+        size_t i = 0;
+
+        this->for_each_line(line_indexes, [&](uint64_t line_index, string_view line){
+            auto h = lines[i++].second;
+
+            split_gfa_line(line, fields, 4);
+
+            if (fields.size() >= 3 and fields[2] != "*"){
+                sequences[h - start] = fields[2];
+            }
+        });
+
+        for (auto& sequence: sequences){
+            buffers_per_job[j].append(sequence);
+        }
+    });
+
+    buffers = {};
+    buffers.bounds.emplace_back(0);
+
+    for (auto& job_buffers: buffers_per_job){
+        buffers.append(job_buffers);
+    }
+}
+
+
+const PackedSequenceStore& GFAReader::get_sequence_store() const{
+    ///
+    /// 2 bit packed copy of every segment sequence, for analyses that access bases repeatedly. Like tag columns, it is
+    /// built on first use, added to the .gfai, and mapped from there by later runs. Safe to call concurrently.
+    ///
+
+    lock_guard<mutex> lock(this->lazy_section_mutex);
+
+    if (this->sequence_store){
+        return *this->sequence_store;
+    }
+
+    // Built and checked in locals, so that a failed call leaves nothing behind for the next one to return
+    auto& file = *this->index_file;
+    auto sequence_store = std::make_unique<PackedSequenceStore>();
+    unique_ptr <PackedSequenceBuffers> sequence_buffers;
+
+    if (file.has_section(SEQUENCE_PACKED)){
+        sequence_store->packed = file.get_section<uint64_t>(SEQUENCE_PACKED);
+        sequence_store->bounds = file.get_section<uint64_t>(SEQUENCE_BOUNDS);
+        sequence_store->exception_positions = file.get_section<uint64_t>(SEQUENCE_EXCEPTION_POSITIONS);
+        sequence_store->exception_bases = file.get_section<char>(SEQUENCE_EXCEPTION_BASES);
+    }
+    else{
+        cerr << "Packing GFA sequences ... ";
+
+        sequence_buffers = std::make_unique<PackedSequenceBuffers>();
+        this->build_sequence_store(*sequence_buffers);
+        *sequence_store = PackedSequenceStore(*sequence_buffers);
+
+        cerr << "done\n";
+    }
+
+    if (sequence_store->size() != this->node_table.size()){
+        throw runtime_error("ERROR: sequence store does not match node table in index: " + this->gfa_index_path.string());
+    }
+
+    this->sequence_store = std::move(sequence_store);
+
+    if (sequence_buffers){
+        this->sequence_buffers = std::move(sequence_buffers);
+
+        this->add_section(SEQUENCE_PACKED, this->sequence_buffers->packed);
+        this->add_section(SEQUENCE_BOUNDS, this->sequence_buffers->bounds);
+        this->add_section(SEQUENCE_EXCEPTION_POSITIONS, this->sequence_buffers->exception_positions);
+        this->add_section(SEQUENCE_EXCEPTION_BASES, this->sequence_buffers->exception_bases);
+
+        this->save_added_sections();
+    }
+
+    return *this->sequence_store;
+}
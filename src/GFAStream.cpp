@@ -0,0 +1,148 @@
+#include "GFAStream.hpp"
+#include <stdexcept>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+using std::runtime_error;
+using std::string;
+
+
+const size_t GFAStream::DEFAULT_BUFFER_SIZE = 4*1024*1024;
+
+
+GFAStream::GFAStream(path gfa_path, size_t buffer_size){
+    this->gfa_path = gfa_path;
+    this->buffer_size = std::max(size_t(1), buffer_size);
+}
+
+
+void GFAStream::set_handler(char type, const GFARecordHandler& handler){
+    this->handlers[type] = handler;
+}
+
+
+void GFAStream::set_default_handler(const GFARecordHandler& handler){
+    this->default_handler = handler;
+}
+
+
+uint64_t GFAStream::stream() const{
+    ///
+    /// Read the whole GFA and dispatch every non-empty line, returning the number of such lines. Lines are
+    /// delimited in place with memchr, and the incomplete line at the end of the buffer is moved to its front before
+    /// the next read. The buffer only grows if a single line does not fit in it.
+    ///
+
+    bool is_stdin = (this->gfa_path == "-");
+    int file_descriptor = is_stdin ? ::dup(STDIN_FILENO) : ::open(this->gfa_path.c_str(), O_RDONLY);
+
+    if (file_descriptor == -1){
+        throw runtime_error("ERROR: file could not be opened: " + this->gfa_path.string());
+    }
+
+    // zlib reads uncompressed input unchanged, so one code path covers every format
+    gzFile gfa_file = gzdopen(file_descriptor, "rb");
+
+    if (gfa_file == nullptr){
+        ::close(file_descriptor);
+        throw runtime_error("ERROR: file could not be opened: " + this->gfa_path.string());
+    }
+
+    gzbuffer(gfa_file, 1024*1024);
+
+    vector <char> buffer(this->buffer_size);
+    vector <string_view> fields;
+    size_t n_filled = 0;
+    uint64_t n_lines = 0;
+
+    auto dispatch = [&](string_view line){
+        while (not line.empty() and line.back() == '\r'){
+            line.remove_suffix(1);
+        }
+
+        if (line.empty()){
+            return;
+        }
+
+        auto result = this->handlers.find(line[0]);
+        auto& handler = (result != this->handlers.end()) ? result->second : this->default_handler;
+
+        n_lines++;
+
+        if (not handler){
+            return;
+        }
+
+        fields.clear();
+        size_t start = 0;
+        while (true){
+            auto stop = line.find('\t', start);
+
+            if (stop == string_view::npos){
+                fields.emplace_back(line.substr(start));
+                break;
+            }
+
+            fields.emplace_back(line.substr(start, stop - start));
+            start = stop + 1;
+        }
+
+        handler(line, fields);
+    };
+
+    try {
+        while (true){
+            if (n_filled == buffer.size()){
+                buffer.resize(buffer.size()*2);
+            }
+
+            auto n_requested = unsigned(std::min(buffer.size() - n_filled, size_t(INT_MAX)));
+            int n_read = gzread(gfa_file, buffer.data() + n_filled, n_requested);
+
+            if (n_read < 0){
+                int error_code;
+                throw runtime_error("ERROR: could not read " + this->gfa_path.string() + ": " + string(gzerror(gfa_file, &error_code)));
+            }
+
+            n_filled += size_t(n_read);
+
+            const char* data = buffer.data();
+            size_t start = 0;
+
+            while (start < n_filled){
+                auto newline = static_cast<const char*>(memchr(data + start, '\n', n_filled - start));
+
+                if (newline == nullptr){
+                    break;
+                }
+
+                dispatch(string_view(data + start, newline - (data + start)));
+                start = size_t(newline - data) + 1;
+            }
+
+            // The last line may have no newline
+            if (n_read == 0){
+                if (start < n_filled){
+                    dispatch(string_view(data + start, n_filled - start));
+                }
+                break;
+            }
+
+            std::memmove(buffer.data(), data + start, n_filled - start);
+            n_filled -= start;
+        }
+    }
+    catch (...){
+        gzclose(gfa_file);
+        throw;
+    }
+
+    gzclose(gfa_file);
+
+    return n_lines;
+}
@@ -0,0 +1,300 @@
+#include "IndexFile.hpp"
+#include <set>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::experimental::filesystem::rename;
+using std::experimental::filesystem::remove;
+
+
+const uint64_t INDEX_HEADER_SIZE = 4*sizeof(uint64_t);
+const uint64_t INDEX_ALIGNMENT = 8;
+
+
+FileLock::FileLock(path file_path, int open_flags, bool exclusive){
+    this->file_path = file_path;
+    this->file_descriptor = ::open(this->file_path.c_str(), open_flags);
+
+    if (this->file_descriptor == -1){
+        throw runtime_error("ERROR: file could not be opened: " + this->file_path.string());
+    }
+
+    if (::flock(this->file_descriptor, exclusive ? LOCK_EX : LOCK_SH) != 0){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR: could not lock file: " + this->file_path.string());
+    }
+}
+
+
+FileLock::~FileLock(){
+    this->release();
+}
+
+
+void FileLock::release(){
+    ///
+    /// Closing the descriptor releases the lock
+    ///
+
+    if (this->file_descriptor != -1){
+        ::close(this->file_descriptor);
+        this->file_descriptor = -1;
+    }
+}
+
+
+IndexFileWriter::IndexFileWriter(path file_path, uint64_t magic, uint64_t version):
+    writer(this->file)
+{
+    ///
+    /// Sections are written to a temporary file which replaces the destination on close(), so that readers which
+    /// currently have the old index mapped are not disturbed, and a partially written index is never left behind.
+    /// The temporary name is unique, so that processes writing the same index at once never share a file.
+    ///
+
+    this->file_path = file_path;
+    this->magic = magic;
+    this->version = version;
+    this->cursor = 0;
+    this->is_closed = false;
+
+    // Same directory as the destination, so that the final rename stays on one filesystem
+    string temp_template = file_path.string() + ".XXXXXX";
+    int temp_descriptor = ::mkstemp(temp_template.data());
+
+    if (temp_descriptor == -1){
+        throw runtime_error("ERROR: could not create temporary index file: " + temp_template);
+    }
+
+    // mkstemp creates the file as private to the user, but an index should be as readable as its source
+    ::fchmod(temp_descriptor, 0644);
+    ::close(temp_descriptor);
+    this->temp_path = temp_template;
+
+    this->file.open(this->temp_path, std::ios::binary);
+
+    if (not this->file.is_open()){
+        remove(this->temp_path);
+        throw runtime_error("ERROR: could not write index file: " + this->temp_path.string());
+    }
+
+    // Header placeholder, the directory location is only known after all sections are written
+    this->writer.write_value(this->magic);
+    this->writer.write_value(this->version);
+    this->writer.write_value(uint64_t(0));
+    this->writer.write_value(uint64_t(0));
+    this->cursor = INDEX_HEADER_SIZE;
+}
+
+
+IndexFileWriter::~IndexFileWriter(){
+    ///
+    /// A writer that is abandoned before close(), e.g. by an exception, leaves nothing behind
+    ///
+
+    if (not this->is_closed){
+        this->file.close();
+
+        std::error_code error;
+        remove(this->temp_path, error);
+    }
+}
+
+
+void IndexFileWriter::write_section(uint64_t id, const char* data, uint64_t size){
+    this->sections.push_back({id, this->cursor, size});
+    this->writer.write_bytes(data, size);
+    this->cursor += size;
+
+    // Pad so that the next section starts on an aligned boundary
+    while (this->cursor % INDEX_ALIGNMENT != 0){
+        this->writer.write_value(uint8_t(0));
+        this->cursor++;
+    }
+}
+
+
+void IndexFileWriter::close(){
+    uint64_t directory_offset = this->cursor;
+    uint64_t n_sections = this->sections.size();
+
+    for (auto& section: this->sections){
+        this->writer.write_value(section.id);
+        this->writer.write_value(section.offset);
+        this->writer.write_value(section.size);
+    }
+
+    // Everything buffered must reach the file before the header is patched
+    this->writer.flush();
+    this->file.seekp(2*sizeof(uint64_t));
+    this->writer.write_value(directory_offset);
+    this->writer.write_value(n_sections);
+    this->writer.flush();
+    this->file.close();
+
+    if (not this->file){
+        throw runtime_error("ERROR: failed to write index file: " + this->temp_path.string());
+    }
+
+    rename(this->temp_path, this->file_path);
+    this->is_closed = true;
+}
+
+
+MappedIndexFile::MappedIndexFile(path file_path, uint64_t magic, uint64_t version):
+    lock(file_path, O_RDONLY, false),
+    file(file_path)
+{
+    ///
+    /// The file is mapped under a shared lock, so that append_sections() can't move the header to a directory beyond
+    /// the end of the mapping while it is read
+    ///
+
+    if (this->file.size < INDEX_HEADER_SIZE){
+        throw runtime_error("ERROR: index file is truncated: " + file_path.string());
+    }
+
+    auto header = reinterpret_cast<const uint64_t*>(this->file.data);
+
+    if (header[0] != magic){
+        throw runtime_error("ERROR: unrecognized index format: " + file_path.string());
+    }
+
+    if (header[1] != version){
+        throw runtime_error("ERROR: index format version " + std::to_string(header[1]) + " does not match expected version " + std::to_string(version) + ": " + file_path.string());
+    }
+
+    uint64_t directory_offset = header[2];
+    uint64_t n_sections = header[3];
+
+    if (directory_offset % INDEX_ALIGNMENT != 0 or directory_offset + n_sections*sizeof(IndexSection) > this->file.size){
+        throw runtime_error("ERROR: index directory is corrupt: " + file_path.string());
+    }
+
+    auto directory = reinterpret_cast<const IndexSection*>(this->file.data + directory_offset);
+
+    for (uint64_t i=0; i<n_sections; i++){
+        auto& section = directory[i];
+
+        if (section.offset + section.size > directory_offset){
+            throw runtime_error("ERROR: index section " + std::to_string(section.id) + " is corrupt: " + file_path.string());
+        }
+
+        this->sections[section.id] = section;
+    }
+
+    this->lock.release();
+}
+
+
+bool MappedIndexFile::has_section(uint64_t id) const{
+    return this->sections.count(id) > 0;
+}
+
+
+void pwrite_all(int file_descriptor, const char* data, uint64_t size, uint64_t offset, const path& file_path){
+    while (size > 0){
+        auto n_bytes = ::pwrite(file_descriptor, data, size, off_t(offset));
+
+        if (n_bytes <= 0){
+            throw runtime_error("ERROR: failed to write index file: " + file_path.string() + ": " + string(::strerror(errno)));
+        }
+
+        data += n_bytes;
+        offset += uint64_t(n_bytes);
+        size -= uint64_t(n_bytes);
+    }
+}
+
+
+void pread_all(int file_descriptor, char* data, uint64_t size, uint64_t offset, const path& file_path){
+    while (size > 0){
+        auto n_bytes = ::pread(file_descriptor, data, size, off_t(offset));
+
+        if (n_bytes <= 0){
+            throw runtime_error("ERROR: failed to read index file: " + file_path.string());
+        }
+
+        data += n_bytes;
+        offset += uint64_t(n_bytes);
+        size -= uint64_t(n_bytes);
+    }
+}
+
+
+void MappedIndexFile::append_sections(const map <uint64_t, ArrayView <char> >& new_sections) const{
+    ///
+    /// Append sections to the file on disk, then a directory listing all sections, and finally point the header at
+    /// the new directory. Existing bytes other than the header are never modified, so other processes can keep the
+    /// file mapped. Appends are serialized by an exclusive lock, under which the directory is read again from disk, so
+    /// sections that other processes appended since this file was mapped are kept, and are not written twice. Fails
+    /// if the file has been replaced since it was mapped, e.g. by a reindex.
+    ///
+
+    FileLock write_lock(this->file.file_path, O_RDWR, true);
+    auto file_descriptor = write_lock.file_descriptor;
+    auto& file_path = this->file.file_path;
+
+    struct stat mapped_stats;
+    struct stat file_stats;
+
+    if (::fstat(this->file.file_descriptor, &mapped_stats) != 0 or ::fstat(file_descriptor, &file_stats) != 0){
+        throw runtime_error("ERROR: could not stat file: " + file_path.string());
+    }
+
+    if (mapped_stats.st_dev != file_stats.st_dev or mapped_stats.st_ino != file_stats.st_ino){
+        throw runtime_error("ERROR: index file was replaced since it was loaded: " + file_path.string());
+    }
+
+    uint64_t header[4];
+    pread_all(file_descriptor, reinterpret_cast<char*>(header), INDEX_HEADER_SIZE, 0, file_path);
+
+    auto mapped_header = reinterpret_cast<const uint64_t*>(this->file.data);
+
+    if (header[0] != mapped_header[0] or header[1] != mapped_header[1]){
+        throw runtime_error("ERROR: unrecognized index format: " + file_path.string());
+    }
+
+    vector <IndexSection> directory(header[3]);
+    pread_all(file_descriptor, reinterpret_cast<char*>(directory.data()), directory.size()*sizeof(IndexSection), header[2], file_path);
+
+    std::set <uint64_t> ids;
+    for (auto& section: directory){
+        ids.insert(section.id);
+    }
+
+    uint64_t cursor = uint64_t(file_stats.st_size);
+    size_t n_existing = directory.size();
+
+    for (auto& [id, data]: new_sections){
+        if (ids.count(id) > 0){
+            continue;
+        }
+
+        // The gap left for alignment reads back as zeros
+        cursor += (INDEX_ALIGNMENT - cursor % INDEX_ALIGNMENT) % INDEX_ALIGNMENT;
+
+        pwrite_all(file_descriptor, data.data(), data.size(), cursor, file_path);
+        directory.push_back({id, cursor, data.size()});
+        cursor += data.size();
+    }
+
+    if (directory.size() == n_existing){
+        return;
+    }
+
+    cursor += (INDEX_ALIGNMENT - cursor % INDEX_ALIGNMENT) % INDEX_ALIGNMENT;
+    pwrite_all(file_descriptor, reinterpret_cast<const char*>(directory.data()), directory.size()*sizeof(IndexSection), cursor, file_path);
+
+    // Everything the new directory describes must be on disk before the header refers to it
+    if (::fdatasync(file_descriptor) != 0){
+        throw runtime_error("ERROR: failed to write index file: " + file_path.string());
+    }
+
+    uint64_t directory_location[2] = {cursor, directory.size()};
+    pwrite_all(file_descriptor, reinterpret_cast<const char*>(directory_location), sizeof(directory_location), 2*sizeof(uint64_t), file_path);
+}
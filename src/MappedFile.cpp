@@ -0,0 +1,52 @@
+#include "MappedFile.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+MappedFile::MappedFile(path file_path){
+    ///
+    /// Map an entire file read-only into memory. Empty files are allowed, and result in a null data pointer
+    ///
+
+    this->file_path = file_path;
+    this->data = nullptr;
+    this->size = 0;
+
+    this->file_descriptor = ::open(this->file_path.c_str(), O_RDONLY);
+
+    if (this->file_descriptor == -1){
+        throw runtime_error("ERROR: file could not be opened: " + this->file_path.string());
+    }
+
+    struct stat file_stats;
+    if (::fstat(this->file_descriptor, &file_stats) != 0){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR: could not stat file: " + this->file_path.string());
+    }
+
+    this->size = uint64_t(file_stats.st_size);
+
+    if (this->size == 0){
+        return;
+    }
+
+    void* address = ::mmap(nullptr, this->size, PROT_READ, MAP_SHARED, this->file_descriptor, 0);
+
+    if (address == MAP_FAILED){
+        ::close(this->file_descriptor);
+        throw runtime_error("ERROR " + std::to_string(errno) + " while mapping " + this->file_path.string() + ": " + string(::strerror(errno)));
+    }
+
+    this->data = static_cast<char*>(address);
+}
+
+
+MappedFile::~MappedFile(){
+    if (this->data != nullptr){
+        ::munmap(this->data, this->size);
+    }
+    ::close(this->file_descriptor);
+}
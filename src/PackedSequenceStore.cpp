@@ -0,0 +1,199 @@
+#include "PackedSequenceStore.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+using std::runtime_error;
+
+
+const uint64_t BASES_PER_WORD = 32;
+
+const char PACKED_BASES[4] = {'A', 'C', 'G', 'T'};
+
+
+int8_t get_base_code(char base){
+    switch (base){
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+        default: return -1;
+    }
+}
+
+
+char get_complement(char base){
+    ///
+    /// Complement of any IUPAC code, preserving case. Codes that are their own complement (N, S, W, gaps) map to
+    /// themselves.
+    ///
+
+    switch (base){
+        case 'A': return 'T';
+        case 'C': return 'G';
+        case 'G': return 'C';
+        case 'T': return 'A';
+        case 'U': return 'A';
+        case 'R': return 'Y';
+        case 'Y': return 'R';
+        case 'K': return 'M';
+        case 'M': return 'K';
+        case 'B': return 'V';
+        case 'V': return 'B';
+        case 'D': return 'H';
+        case 'H': return 'D';
+        case 'a': return 't';
+        case 'c': return 'g';
+        case 'g': return 'c';
+        case 't': return 'a';
+        case 'u': return 'a';
+        case 'r': return 'y';
+        case 'y': return 'r';
+        case 'k': return 'm';
+        case 'm': return 'k';
+        case 'b': return 'v';
+        case 'v': return 'b';
+        case 'd': return 'h';
+        case 'h': return 'd';
+        default: return base;
+    }
+}
+
+
+void reverse_complement_in_place(string& sequence){
+    std::reverse(sequence.begin(), sequence.end());
+    std::transform(sequence.begin(), sequence.end(), sequence.begin(), get_complement);
+}
+
+
+void PackedSequenceBuffers::append(string_view sequence){
+    ///
+    /// Add one sequence after all the previous ones. The first call also starts the bounds with 0.
+    ///
+
+    if (this->bounds.empty()){
+        this->bounds.emplace_back(0);
+    }
+
+    uint64_t position = this->bounds.back();
+    uint64_t stop = position + sequence.size();
+
+    this->packed.resize((stop + BASES_PER_WORD - 1)/BASES_PER_WORD, 0);
+
+    for (auto base: sequence){
+        auto code = get_base_code(base);
+
+        if (code < 0){
+            this->exception_positions.emplace_back(position);
+            this->exception_bases.emplace_back(base);
+            code = 0;
+        }
+
+        this->packed[position/BASES_PER_WORD] |= uint64_t(code) << (2*(position % BASES_PER_WORD));
+        position++;
+    }
+
+    this->bounds.emplace_back(stop);
+}
+
+
+void PackedSequenceBuffers::append(const PackedSequenceBuffers& other){
+    ///
+    /// Concatenate another store after this one. When this one doesn't end on a word boundary, every word of the other
+    /// is split across two words, shifted by the number of bases already in the last word.
+    ///
+
+    if (this->bounds.empty()){
+        this->bounds.emplace_back(0);
+    }
+
+    if (other.bounds.empty()){
+        return;
+    }
+
+    uint64_t start = this->bounds.back();
+    uint64_t stop = start + other.bounds.back();
+    uint64_t shift = 2*(start % BASES_PER_WORD);
+    uint64_t first_word = start/BASES_PER_WORD;
+
+    this->packed.resize((stop + BASES_PER_WORD - 1)/BASES_PER_WORD, 0);
+
+    for (size_t w=0; w<other.packed.size(); w++){
+        this->packed[first_word + w] |= other.packed[w] << shift;
+
+        if (shift > 0 and first_word + w + 1 < this->packed.size()){
+            this->packed[first_word + w + 1] |= other.packed[w] >> (64 - shift);
+        }
+    }
+
+    for (size_t i=1; i<other.bounds.size(); i++){
+        this->bounds.emplace_back(start + other.bounds[i]);
+    }
+
+    for (auto& position: other.exception_positions){
+        this->exception_positions.emplace_back(start + position);
+    }
+
+    this->exception_bases.insert(this->exception_bases.end(), other.exception_bases.begin(), other.exception_bases.end());
+}
+
+
+PackedSequenceStore::PackedSequenceStore() = default;
+
+
+PackedSequenceStore::PackedSequenceStore(const PackedSequenceBuffers& buffers):
+    packed(buffers.packed.data(), buffers.packed.size()),
+    bounds(buffers.bounds.data(), buffers.bounds.size()),
+    exception_positions(buffers.exception_positions.data(), buffers.exception_positions.size()),
+    exception_bases(buffers.exception_bases.data(), buffers.exception_bases.size())
+{}
+
+
+size_t PackedSequenceStore::size() const{
+    return this->bounds.empty() ? 0 : this->bounds.size() - 1;
+}
+
+
+uint64_t PackedSequenceStore::get_base_count() const{
+    return this->bounds.empty() ? 0 : this->bounds.back();
+}
+
+
+uint64_t PackedSequenceStore::get_length(NodeHandle handle) const{
+    return this->bounds.at(handle + 1) - this->bounds[handle];
+}
+
+
+void PackedSequenceStore::get_sequence(NodeHandle handle, string& sequence) const{
+    this->get_sequence(handle, 0, this->get_length(handle), false, sequence);
+}
+
+
+void PackedSequenceStore::get_sequence(NodeHandle handle, uint64_t start, uint64_t length, bool reverse_complement, string& sequence) const{
+    ///
+    /// Extract `length` bases starting at `start` of the forward sequence, optionally reverse complemented, so that
+    /// e.g. the last k bases of a reversed segment are get_sequence(h, 0, k, true, s)
+    ///
+
+    if (start + length > this->get_length(handle)){
+        throw runtime_error("ERROR: range " + std::to_string(start) + "+" + std::to_string(length) + " is beyond the end of sequence " + std::to_string(handle));
+    }
+
+    uint64_t first = this->bounds[handle] + start;
+    uint64_t stop = first + length;
+
+    sequence.resize(length);
+
+    for (uint64_t p=first; p<stop; p++){
+        sequence[p - first] = PACKED_BASES[(this->packed[p/BASES_PER_WORD] >> (2*(p % BASES_PER_WORD))) & 3];
+    }
+
+    auto begin = std::lower_bound(this->exception_positions.begin(), this->exception_positions.end(), first);
+
+    for (auto e=begin; e != this->exception_positions.end() and *e < stop; e++){
+        sequence[*e - first] = this->exception_bases[e - this->exception_positions.begin()];
+    }
+
+    if (reverse_complement){
+        reverse_complement_in_place(sequence);
+    }
+}
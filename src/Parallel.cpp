@@ -0,0 +1,63 @@
+#include "Parallel.hpp"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using std::atomic;
+using std::thread;
+using std::vector;
+using std::mutex;
+using std::lock_guard;
+using std::exception_ptr;
+
+
+void run_jobs_in_parallel(size_t n_jobs, size_t n_threads, const function<void(size_t job_index)>& job){
+    ///
+    /// Run job(0) ... job(n_jobs-1) on up to n_threads threads. Each thread claims the next unclaimed job index until
+    /// none are left, so jobs of uneven cost are balanced automatically. With one thread, jobs run on the caller.
+    /// If any job throws, the remaining jobs are skipped and the first exception is rethrown on the calling thread.
+    ///
+
+    n_threads = std::min(std::max(size_t(1), n_threads), n_jobs);
+
+    if (n_threads <= 1){
+        for (size_t i=0; i<n_jobs; i++){
+            job(i);
+        }
+        return;
+    }
+
+    atomic <size_t> job_index(0);
+    exception_ptr error = nullptr;
+    mutex error_mutex;
+
+    auto run_jobs = [&](){
+        try {
+            for (size_t i = job_index.fetch_add(1); i < n_jobs; i = job_index.fetch_add(1)){
+                job(i);
+            }
+        }
+        catch (...){
+            lock_guard<mutex> lock(error_mutex);
+            if (not error){
+                error = std::current_exception();
+            }
+            job_index = n_jobs;
+        }
+    };
+
+    vector <thread> threads;
+    for (size_t t=0; t<n_threads; t++){
+        threads.emplace_back(run_jobs);
+    }
+    for (auto& t: threads){
+        t.join();
+    }
+
+    if (error){
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,125 @@
+#include "VCFIndex.hpp"
+#include <algorithm>
+#include <sys/stat.h>
+
+using std::runtime_error;
+
+
+const uint64_t VCFIndex::WINDOW_BITS = 14;
+const uint64_t VCFIndex::INDEX_MAGIC = 0x3149464356;     // "VCFI1" in little endian
+const uint64_t VCFIndex::INDEX_VERSION = 1;
+
+
+bool VCFSourceStamp::operator==(const VCFSourceStamp& other) const{
+    return this->file_size == other.file_size
+        and this->mtime_seconds == other.mtime_seconds
+        and this->mtime_nanoseconds == other.mtime_nanoseconds;
+}
+
+
+VCFSourceStamp get_vcf_source_stamp(const MappedFile& vcf_file){
+    struct stat file_stats;
+
+    if (::fstat(vcf_file.file_descriptor, &file_stats) != 0){
+        throw runtime_error("ERROR: could not stat file: " + vcf_file.file_path.string());
+    }
+
+    VCFSourceStamp stamp;
+    stamp.file_size = vcf_file.size;
+    stamp.mtime_seconds = file_stats.st_mtim.tv_sec;
+    stamp.mtime_nanoseconds = file_stats.st_mtim.tv_nsec;
+
+    return stamp;
+}
+
+
+void VCFIndexBuffers::add_chromosome(string_view name){
+    this->chromosome_names.insert(this->chromosome_names.end(), name.begin(), name.end());
+    this->chromosome_name_bounds.emplace_back(this->chromosome_names.size());
+    this->window_bounds.emplace_back(this->window_offsets.size());
+}
+
+
+void VCFIndexBuffers::add_record(uint64_t offset, uint64_t start, uint64_t stop){
+    ///
+    /// Add a record of the last chromosome, covering [start, stop) in 0-based coordinates. Records arrive sorted, so
+    /// only windows past the end of the chromosome's windows are still unset. Windows skipped over, which no record
+    /// overlaps, get the offset of this record, the first one after them.
+    ///
+
+    auto first_window = this->window_bounds[this->window_bounds.size() - 2];
+    auto last_window = first_window + ((std::max(stop, start + 1) - 1) >> VCFIndex::WINDOW_BITS);
+
+    while (this->window_offsets.size() <= last_window){
+        this->window_offsets.emplace_back(offset);
+    }
+
+    this->window_bounds.back() = this->window_offsets.size();
+}
+
+
+void VCFIndexBuffers::write(path index_path) const{
+    IndexFileWriter index_file(index_path, VCFIndex::INDEX_MAGIC, VCFIndex::INDEX_VERSION);
+
+    index_file.write_section(VCF_SOURCE_STAMP, this->source_stamp);
+    index_file.write_section(VCF_CHROMOSOME_NAMES, this->chromosome_names);
+    index_file.write_section(VCF_CHROMOSOME_NAME_BOUNDS, this->chromosome_name_bounds);
+    index_file.write_section(VCF_WINDOW_BOUNDS, this->window_bounds);
+    index_file.write_section(VCF_WINDOW_OFFSETS, this->window_offsets);
+
+    if (not this->bgzf_compressed_offsets.empty()){
+        index_file.write_section(VCF_BGZF_COMPRESSED_OFFSETS, this->bgzf_compressed_offsets);
+        index_file.write_section(VCF_BGZF_UNCOMPRESSED_OFFSETS, this->bgzf_uncompressed_offsets);
+    }
+
+    index_file.close();
+}
+
+
+VCFIndex::VCFIndex(path index_path){
+    this->index_file = std::make_unique<MappedIndexFile>(index_path, INDEX_MAGIC, INDEX_VERSION);
+
+    auto& file = *this->index_file;
+
+    this->chromosome_names = file.get_section<char>(VCF_CHROMOSOME_NAMES);
+    this->chromosome_name_bounds = file.get_section<uint64_t>(VCF_CHROMOSOME_NAME_BOUNDS);
+    this->window_bounds = file.get_section<uint64_t>(VCF_WINDOW_BOUNDS);
+    this->window_offsets = file.get_section<uint64_t>(VCF_WINDOW_OFFSETS);
+
+    if (this->window_bounds.size() != this->chromosome_name_bounds.size()){
+        throw runtime_error("ERROR: chromosome columns do not match in index: " + index_path.string());
+    }
+}
+
+
+VCFSourceStamp VCFIndex::get_indexed_source_stamp() const{
+    return this->index_file->get_section<VCFSourceStamp>(VCF_SOURCE_STAMP).at(0);
+}
+
+
+bool VCFIndex::find_offset(string_view chromosome, uint64_t start, uint64_t& offset) const{
+    ///
+    /// Offset of the first record of a chromosome that may overlap [start, ...) in 0-based coordinates. Returns false
+    /// if the chromosome is not in the index, or none of its records reach the start.
+    ///
+
+    for (size_t i=0; i+1<this->chromosome_name_bounds.size(); i++){
+        auto a = this->chromosome_name_bounds[i];
+        auto b = this->chromosome_name_bounds[i+1];
+
+        if (string_view(this->chromosome_names.data() + a, b - a) != chromosome){
+            continue;
+        }
+
+        auto window = this->window_bounds[i] + (start >> WINDOW_BITS);
+
+        if (window >= this->window_bounds[i+1]){
+            return false;
+        }
+
+        offset = this->window_offsets[window];
+        return true;
+    }
+
+    return false;
+}
@@ -1,10 +1,16 @@
 
 #include "VCFReader.hpp"
+#include "Parallel.hpp"
+#include <unordered_set>
 #include <iostream>
 #include <stdexcept>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+#include <limits>
 
-using std::stoi;
 using std::cout;
+using std::cerr;
 using std::runtime_error;
 
 
@@ -20,119 +26,783 @@ string Variant::to_string(char separator){
 }
 
 
-VCFReader::VCFReader(path vcf_path){
-    this->vcf_path = vcf_path;
+const uint64_t VCFReader::BYTES_PER_CHUNK = 4*1024*1024;
+const uint64_t VCFReader::BYTES_PER_QUERY_CHUNK = 64*1024;
 
-    // Test file
-    ifstream test_stream(this->vcf_path);
-    if (not test_stream.is_open()){
-        throw runtime_error("ERROR: file could not be opened: " + this->vcf_path.string());
+
+VCFReader::VCFReader(path vcf_path):
+    vcf_path(vcf_path),
+    vcf_index_path(vcf_path.string() + ".vcfi"),
+    vcf_file(vcf_path),
+    text_size(this->vcf_file.size),
+    cursor(0),
+    window_start(0)
+{
+    ///
+    /// A BGZF compressed VCF is read through its block table, which is taken from the index if there is a current
+    /// one, so that a region query doesn't have to walk every block header of the file
+    ///
+
+    if (std::experimental::filesystem::exists(this->vcf_index_path)){
+        try {
+            this->load_index();
+        }
+        catch (runtime_error& e){
+            this->index.reset();
+        }
+    }
+
+    if (BGZFReader::is_bgzf(this->vcf_file.data, this->vcf_file.size)){
+        this->bgzf_reader = std::make_unique<BGZFReader>(this->vcf_path);
+
+        if (this->index and this->index->index_file->has_section(VCF_BGZF_COMPRESSED_OFFSETS)){
+            auto& file = *this->index->index_file;
+            this->bgzf_reader->load_blocks(file.get_section<uint64_t>(VCF_BGZF_COMPRESSED_OFFSETS), file.get_section<uint64_t>(VCF_BGZF_UNCOMPRESSED_OFFSETS));
+        }
+        else{
+            this->bgzf_reader->index_blocks();
+        }
+
+        this->text_size = this->bgzf_reader->get_uncompressed_size();
+    }
+    else if (BGZFReader::is_gzip(this->vcf_file.data, this->vcf_file.size)){
+        throw runtime_error("ERROR: VCF is gzip compressed but not BGZF, recompress it with bgzip: " + this->vcf_path.string());
     }
 }
 
 
-void VCFReader::parse_genotype(ifstream& vcf_file, char& c, Variant& variant){
-    string token;
+void VCFReader::set_chromosome_change_handler(const ChromosomeChangeHandler& f){
+    this->on_chromosome_change = f;
+}
 
-    while (vcf_file.get(c)){
-        if (c == '/' or c == '|' or c == '\n' or c == '\t'){
-            if (token == "."){
-                if (c == '/' or c == '|') {
-                    variant.genotype.first = 0;
-                    token.resize(0);
-                }
-                else{
-                    variant.genotype.second = 0;
-                    break;
-                }
-            }
-            else{
-                if (c == '/' or c == '|') {
-                    variant.genotype.first = stoi(token);
-                    token.resize(0);
-                }
-                else{
-                    variant.genotype.second = stoi(token);
-                    break;
-                }
-            }
+
+void VCFReader::rewind(){
+    this->cursor = 0;
+    this->window_start = 0;
+    this->window_text = {};
+    this->current_chromosome.clear();
+}
+
+
+template <class T> bool parse_integer(string_view token, T& value){
+    ///
+    /// Parse the numeric prefix of a token, e.g. 30 from "30.5", and report whether there was one
+    ///
+
+    auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+    return result.ec == std::errc();
+}
+
+
+const uint8_t GenotypeMatrix::PHASED = 1;
+const uint8_t GenotypeMatrix::FIRST_MISSING = 2;
+const uint8_t GenotypeMatrix::SECOND_MISSING = 4;
+
+
+GenotypeMatrix::GenotypeMatrix(const vector <uint16_t>& sample_numbers):
+    sample_numbers(sample_numbers),
+    alleles(2*sample_numbers.size()),
+    flags(sample_numbers.size()),
+    n_records(0)
+{
+    for (size_t i=0; i<sample_numbers.size(); i++){
+        auto n = sample_numbers[i];
+
+        if (n >= this->sample_indexes.size()){
+            this->sample_indexes.resize(size_t(n) + 1, -1);
         }
-        else{
-            token += c;
+
+        if (this->sample_indexes[n] != -1){
+            throw runtime_error("ERROR: sample " + std::to_string(n) + " is selected more than once");
+        }
+
+        this->sample_indexes[n] = int32_t(i);
+    }
+}
+
+
+size_t GenotypeMatrix::get_sample_count() const{
+    return this->sample_numbers.size();
+}
+
+
+void GenotypeMatrix::clear(){
+    for (auto& column: this->alleles){
+        column.clear();
+    }
+    for (auto& column: this->flags){
+        column.clear();
+    }
+
+    this->n_records = 0;
+}
+
+
+void GenotypeMatrix::add_record(){
+    ///
+    /// Add a row of reference alleles, missing in every sample until they are set. Samples with no column in the
+    /// record stay that way.
+    ///
+
+    for (auto& column: this->alleles){
+        column.emplace_back(0);
+    }
+    for (auto& column: this->flags){
+        column.emplace_back(FIRST_MISSING | SECOND_MISSING);
+    }
+
+    this->n_records++;
+}
+
+
+void GenotypeMatrix::append(const GenotypeMatrix& other, size_t record){
+    for (size_t c=0; c<this->alleles.size(); c++){
+        this->alleles[c].emplace_back(other.alleles[c][record]);
+    }
+    for (size_t c=0; c<this->flags.size(); c++){
+        this->flags[c].emplace_back(other.flags[c][record]);
+    }
+
+    this->n_records++;
+}
+
+
+uint8_t GenotypeMatrix::get_allele(size_t record, size_t sample_index, bool haplotype) const{
+    return this->alleles[2*sample_index + haplotype][record];
+}
+
+
+bool GenotypeMatrix::is_phased(size_t record, size_t sample_index) const{
+    return (this->flags[sample_index][record] & PHASED) != 0;
+}
+
+
+void VCFReader::parse_genotype(string_view field, uint8_t& first, uint8_t& second, uint8_t& flags){
+    ///
+    /// Alleles of the GT subfield, which comes first in the sample column, e.g. "0|1:35". Missing alleles (".") are
+    /// taken as the reference and flagged, and a haploid call only sets the second allele. Alleles are stored in 8
+    /// bits, so an allele index above 255 is an error rather than being silently wrapped.
+    ///
+
+    auto genotype = field.substr(0, field.find(':'));
+    auto gt = genotype;
+    auto separator = gt.find_first_of("/|");
+
+    uint32_t allele = 0;
+    flags = 0;
+
+    auto check_allele = [&](){
+        if (allele > std::numeric_limits<uint8_t>::max()){
+            throw runtime_error("ERROR: allele index " + std::to_string(allele) + " is too large (max 255) in genotype: " + string(genotype));
+        }
+    };
+
+    if (separator != string_view::npos){
+        if (not parse_integer(gt.substr(0, separator), allele)){
+            flags |= GenotypeMatrix::FIRST_MISSING;
+        }
+        if (gt[separator] == '|'){
+            flags |= GenotypeMatrix::PHASED;
         }
+
+        check_allele();
+        first = uint8_t(allele);
+        gt = gt.substr(separator + 1);
+    }
+
+    allele = 0;
+    if (not parse_integer(gt, allele)){
+        flags |= GenotypeMatrix::SECOND_MISSING;
     }
+
+    check_allele();
+    second = uint8_t(allele);
+}
+
+
+void VCFReader::parse_genotype(string_view field, Variant& variant){
+    uint8_t flags;
+    parse_genotype(field, variant.genotype.first, variant.genotype.second, flags);
 }
 
 
-void VCFReader::read_all(map <string, vector <Variant> >& variants, uint16_t sample_number){
+const char* VCFReader::parse_fixed_columns(string_view line, Variant& variant){
     ///
-    /// Parse a vcf with the format:
+    /// Parse the columns before the samples of a data line of a vcf with the format:
     /// #CHROM	POS	ID	REF	ALT	QUAL	FILTER	INFO	FORMAT	HG005733
     ///
+    /// The variant is overwritten, reusing the storage of its strings. Alternate alleles are split on commas. Returns
+    /// the start of the first sample column, or null if there is none.
+    ///
 
-    ifstream vcf_file(this->vcf_path);
-    string token;
-    char c;
+    variant.reference_start = 0;
+    variant.quality = 0;
+    variant.pass = false;
+    variant.genotype = {0,0};
 
-    Variant variant;
-    uint8_t n_separators = 0;
+    size_t n_alleles = 0;
 
-    while(vcf_file.get(c)){
-        // If this line is a header skip until newline character
-        if (c == '#'){
-            while(c != '\n'){
-                vcf_file.get(c);
-            }
-            token.resize(0);
-            continue;
+    auto add_allele = [&](string_view allele){
+        if (n_alleles < variant.alleles.size()){
+            variant.alleles[n_alleles].assign(allele.data(), allele.size());
+        }
+        else{
+            variant.alleles.emplace_back(allele);
         }
+        n_alleles++;
+    };
+
+    const char* position = line.data();
+    const char* end = line.data() + line.size();
+
+    for (size_t column=0; column < 9; column++){
+        auto tab = static_cast<const char*>(memchr(position, '\t', end - position));
+        auto stop = (tab == nullptr) ? end : tab;
+        string_view field(position, stop - position);
 
-        // If this line contains data, parse it
-        if ((c == '\t') or (c == '\n') or (c == ',')){
-            if (n_separators == 0){
-                variant.chromosome = token;
+        if (column == 0){
+            variant.chromosome.assign(field.data(), field.size());
+        }
+        else if (column == 1){
+            if (not parse_integer(field, variant.reference_start)){
+                throw runtime_error("ERROR: invalid POS '" + string(field) + "' in VCF line: " + string(line));
             }
-            else if (n_separators == 1){
-                variant.reference_start = uint64_t(stoi(token));
+        }
+        else if (column == 3 or column == 4){
+            size_t comma;
+            while ((comma = field.find(',')) != string_view::npos){
+                add_allele(field.substr(0, comma));
+                field = field.substr(comma + 1);
             }
-            else if (n_separators == 3 or n_separators == 4){
-                variant.alleles.push_back(token);
+            add_allele(field);
+        }
+        else if (column == 5){
+            int quality = 0;
+            parse_integer(field, quality);
+            variant.quality = uint8_t(quality);
+        }
+        else if (column == 6){
+            variant.pass = (field == "PASS");
+        }
+
+        if (tab == nullptr){
+            position = nullptr;
+            break;
+        }
+
+        position = tab + 1;
+    }
+
+    variant.alleles.resize(n_alleles);
+
+    return position;
+}
+
+
+string_view next_column(const char*& position, const char* end){
+    ///
+    /// Column starting at the position, which is advanced to the next column, or set to null after the last one
+    ///
+
+    auto tab = static_cast<const char*>(memchr(position, '\t', end - position));
+    auto stop = (tab == nullptr) ? end : tab;
+    string_view column(position, stop - position);
+
+    position = (tab == nullptr) ? nullptr : tab + 1;
+
+    return column;
+}
+
+
+void VCFReader::parse_record(string_view line, Variant& variant, uint16_t sample_number){
+    ///
+    /// Parse a data line, with the genotype of one sample. Parsing stops at that sample's column.
+    ///
+
+    auto position = parse_fixed_columns(line, variant);
+    const char* end = line.data() + line.size();
+
+    for (size_t i=0; position != nullptr; i++){
+        auto column = next_column(position, end);
+
+        if (i == sample_number){
+            parse_genotype(column, variant);
+            break;
+        }
+    }
+}
+
+
+void VCFReader::parse_record(string_view line, Variant& variant, GenotypeMatrix& genotypes){
+    ///
+    /// Parse a data line, adding the genotypes of all selected samples to a new row of the matrix. The variant gets
+    /// the genotype of the first selected sample. Parsing stops at the last selected column.
+    ///
+
+    auto position = parse_fixed_columns(line, variant);
+    const char* end = line.data() + line.size();
+
+    genotypes.add_record();
+    auto record = genotypes.n_records - 1;
+
+    for (size_t i=0; position != nullptr and i < genotypes.sample_indexes.size(); i++){
+        auto column = next_column(position, end);
+        auto s = genotypes.sample_indexes[i];
+
+        if (s < 0){
+            continue;
+        }
+
+        parse_genotype(column, genotypes.alleles[2*s][record], genotypes.alleles[2*s + 1][record], genotypes.flags[s][record]);
+
+        if (s == 0){
+            variant.genotype = {genotypes.alleles[0][record], genotypes.alleles[1][record]};
+        }
+    }
+}
+
+
+void VCFReader::read_text(uint64_t start, uint64_t stop, vector <char>& buffer, string_view& text) const{
+    ///
+    /// View of the VCF text in [start, stop), decompressed into the buffer if the VCF is BGZF compressed, and taken
+    /// directly from the mapped file otherwise
+    ///
+
+    if (this->bgzf_reader){
+        buffer.resize(stop - start);
+        this->bgzf_reader->read(start, stop - start, buffer.data());
+        text = string_view(buffer.data(), buffer.size());
+    }
+    else{
+        text = string_view(this->vcf_file.data + start, stop - start);
+    }
+}
+
+
+uint64_t VCFReader::find_line_end(uint64_t offset) const{
+    ///
+    /// Position just after the first newline at or after an offset, or the end of the text if there is none
+    ///
+
+    vector <char> buffer;
+    string_view text;
+
+    while (offset < this->text_size){
+        auto stop = std::min(this->text_size, offset + BYTES_PER_QUERY_CHUNK);
+        this->read_text(offset, stop, buffer, text);
+
+        auto newline = static_cast<const char*>(memchr(text.data(), '\n', text.size()));
+
+        if (newline != nullptr){
+            return offset + uint64_t(newline - text.data()) + 1;
+        }
+
+        offset = stop;
+    }
+
+    return this->text_size;
+}
+
+
+bool VCFReader::find_next_record(string_view text, uint64_t& cursor, string_view& line){
+    ///
+    /// Advance the cursor past the next data line of the text, skipping headers and blank lines
+    ///
+
+    while (cursor < text.size()){
+        const char* start = text.data() + cursor;
+        auto newline = static_cast<const char*>(memchr(start, '\n', text.size() - cursor));
+        const char* end = (newline == nullptr) ? text.data() + text.size() : newline;
+
+        cursor = end - text.data() + 1;
+        line = string_view(start, end - start);
+
+        if (not line.empty() and line.back() == '\r'){
+            line.remove_suffix(1);
+        }
+
+        if (not line.empty() and line[0] != '#'){
+            return true;
+        }
+    }
+
+    cursor = text.size();
+
+    return false;
+}
+
+
+void VCFReader::update_chromosome(const string& chromosome){
+    if (chromosome != this->current_chromosome){
+        if (this->on_chromosome_change){
+            this->on_chromosome_change(this->current_chromosome, chromosome);
+        }
+        this->current_chromosome = chromosome;
+    }
+}
+
+
+bool VCFReader::next(Variant& variant, uint16_t sample_number){
+    ///
+    /// Parse the next record. Returns false at the end of the file. When the chromosome differs from the previous
+    /// record's, the chromosome change handler is called first, and it is called once more at the end of the file.
+    /// The text is read one chunk at a time, each ending on a newline.
+    ///
+
+    string_view line;
+
+    while (true){
+        uint64_t window_cursor = this->cursor - this->window_start;
+
+        if (find_next_record(this->window_text, window_cursor, line)){
+            this->cursor = this->window_start + window_cursor;
+
+            parse_record(line, variant, sample_number);
+            this->update_chromosome(variant.chromosome);
+            return true;
+        }
+
+        this->cursor = this->window_start + this->window_text.size();
+
+        if (this->cursor >= this->text_size){
+            break;
+        }
+
+        auto stop = this->find_line_end(std::min(this->text_size, this->cursor + BYTES_PER_CHUNK) - 1);
+        this->window_start = this->cursor;
+        this->read_text(this->window_start, stop, this->window, this->window_text);
+    }
+
+    // The last chromosome ends with the file
+    this->update_chromosome("");
+
+    return false;
+}
+
+
+void VCFReader::for_each_chunk(
+        const function<void(size_t slot, uint64_t offset, string_view text)>& parse,
+        const function<void(size_t slot)>& consume,
+        size_t n_threads){
+    ///
+    /// Cut the VCF into chunks which end on a newline, and parse each batch of n_threads chunks in parallel, one per
+    /// slot. Once a batch is parsed, its slots are consumed in file order from the calling thread, so memory is
+    /// bounded by the size of a batch.
+    ///
+
+    n_threads = std::max(size_t(1), n_threads);
+
+    vector <vector <char> > buffers(n_threads);
+    vector <pair <uint64_t, uint64_t> > chunks(n_threads);
+    uint64_t offset = 0;
+
+    while (offset < this->text_size){
+        size_t n_chunks = 0;
+
+        while (n_chunks < n_threads and offset < this->text_size){
+            auto stop = this->find_line_end(std::min(this->text_size, offset + BYTES_PER_CHUNK) - 1);
+            chunks[n_chunks++] = {offset, stop};
+            offset = stop;
+        }
+
+        run_jobs_in_parallel(n_chunks, n_threads, [&](size_t c){
+            string_view text;
+            this->read_text(chunks[c].first, chunks[c].second, buffers[c], text);
+            parse(c, chunks[c].first, text);
+        });
+
+        for (size_t c=0; c<n_chunks; c++){
+            consume(c);
+        }
+    }
+}
+
+
+void VCFReader::for_each(const GenotypeHandler& f, const vector <uint16_t>& sample_numbers, size_t n_threads){
+    ///
+    /// Call f on every record from the start of the file, in file order, with the genotypes of the selected samples,
+    /// and the chromosome change handler called as in next(). Chunks of the file are parsed in parallel.
+    ///
+
+    this->rewind();
+
+    n_threads = std::max(size_t(1), n_threads);
+
+    // The variants and genotypes of each slot are kept between batches so their storage is reused
+    vector <vector <Variant> > variants_per_slot(n_threads);
+    vector <GenotypeMatrix> genotypes_per_slot(n_threads, GenotypeMatrix(sample_numbers));
+
+    this->for_each_chunk([&](size_t slot, uint64_t offset, string_view text){
+        auto& variants = variants_per_slot[slot];
+        auto& genotypes = genotypes_per_slot[slot];
+        uint64_t cursor = 0;
+        string_view line;
+
+        genotypes.clear();
+
+        while (find_next_record(text, cursor, line)){
+            if (genotypes.n_records == variants.size()){
+                variants.emplace_back();
             }
-            else if (n_separators == 5){
-                variant.quality = uint8_t(stoi(token));
+            parse_record(line, variants[genotypes.n_records], genotypes);
+        }
+    },
+    [&](size_t slot){
+        auto& genotypes = genotypes_per_slot[slot];
+
+        for (size_t i=0; i<genotypes.n_records; i++){
+            this->update_chromosome(variants_per_slot[slot][i].chromosome);
+            f(variants_per_slot[slot][i], genotypes, i);
+        }
+    }, n_threads);
+
+    this->update_chromosome("");
+}
+
+
+void VCFReader::for_each(const function<void(const Variant& variant)>& f, uint16_t sample_number, size_t n_threads){
+    this->for_each([&](const Variant& variant, const GenotypeMatrix& genotypes, size_t record){
+        f(variant);
+    }, {sample_number}, n_threads);
+}
+
+
+void VCFReader::read_all(map <string, vector <Variant> >& variants, uint16_t sample_number, size_t n_threads){
+    ///
+    /// Load every record, grouped by chromosome in file order. Starts from the beginning of the file regardless of
+    /// any previous calls to next(). The result is the same for any number of threads.
+    ///
+
+    this->for_each([&](const Variant& variant){
+        variants[variant.chromosome].push_back(variant);
+    }, sample_number, n_threads);
+}
+
+
+bool VCFReader::load_index(){
+    ///
+    /// Map the .vcfi, and keep it only if it was built from the VCF as it is now
+    ///
+
+    this->index = std::make_unique<VCFIndex>(this->vcf_index_path);
+
+    if (not (this->index->get_indexed_source_stamp() == get_vcf_source_stamp(this->vcf_file))){
+        this->index.reset();
+        return false;
+    }
+
+    return true;
+}
+
+
+void VCFReader::build_index(size_t n_threads){
+    ///
+    /// Write the .vcfi of a VCF sorted by chromosome and position, by scanning the records in parallel chunks. Each
+    /// record covers its reference allele, which is what a haploblock replaces.
+    ///
+
+    class IndexEntry{
+    public:
+        uint64_t offset;
+        uint64_t start;
+        uint64_t stop;
+        size_t chromosome;
+    };
+
+    n_threads = std::max(size_t(1), n_threads);
+
+    VCFIndexBuffers buffers;
+    buffers.source_stamp = get_vcf_source_stamp(this->vcf_file);
+
+    if (this->bgzf_reader){
+        buffers.bgzf_compressed_offsets = this->bgzf_reader->compressed_offsets;
+        buffers.bgzf_uncompressed_offsets = this->bgzf_reader->uncompressed_offsets;
+    }
+
+    // Chromosome names are only stored when they change within a chunk
+    vector <vector <IndexEntry> > entries_per_slot(n_threads);
+    vector <vector <string> > chromosomes_per_slot(n_threads);
+
+    std::unordered_set <string> finished_chromosomes;
+    string chromosome;
+    uint64_t previous_start = 0;
+
+    this->for_each_chunk([&](size_t slot, uint64_t offset, string_view text){
+        auto& entries = entries_per_slot[slot];
+        auto& chromosomes = chromosomes_per_slot[slot];
+        uint64_t cursor = 0;
+        string_view line;
+        Variant variant;
+
+        entries.clear();
+        chromosomes.clear();
+
+        while (find_next_record(text, cursor, line)){
+            auto line_start = uint64_t(line.data() - text.data());
+            parse_record(line, variant, 0);
+
+            if (chromosomes.empty() or chromosomes.back() != variant.chromosome){
+                chromosomes.emplace_back(variant.chromosome);
             }
-            else if (n_separators == 6){
-                if (token == "PASS"){
-                    variant.pass = true;
-                }
-                else{
-                    variant.pass = false;
+
+            auto start = variant.reference_start - std::min(variant.reference_start, uint64_t(1));
+            auto stop = start + variant.alleles.at(0).size();
+
+            entries.push_back({offset + line_start, start, stop, chromosomes.size() - 1});
+        }
+    },
+    [&](size_t slot){
+        auto& chromosomes = chromosomes_per_slot[slot];
+
+        for (auto& entry: entries_per_slot[slot]){
+            if (chromosomes[entry.chromosome] != chromosome){
+                finished_chromosomes.insert(chromosome);
+
+                if (finished_chromosomes.count(chromosomes[entry.chromosome]) > 0){
+                    throw runtime_error("ERROR: VCF must be sorted by chromosome and position to be indexed, chromosome '" + chromosomes[entry.chromosome] + "' is not contiguous: " + this->vcf_path.string());
                 }
-            }
-            else if (n_separators == (8 + sample_number)){
-                parse_genotype(vcf_file, c, variant);
+
+                chromosome = chromosomes[entry.chromosome];
+                buffers.add_chromosome(chromosome);
+                previous_start = 0;
             }
 
-            if (c == '\t' or c == '\n'){
-                n_separators++;
+            if (entry.start < previous_start){
+                throw runtime_error("ERROR: VCF must be sorted by chromosome and position to be indexed, position " + std::to_string(entry.start + 1) + " of '" + chromosome + "' is out of order: " + this->vcf_path.string());
             }
 
-            token.resize(0);
+            previous_start = entry.start;
+            buffers.add_record(entry.offset, entry.start, entry.stop);
+        }
+    }, n_threads);
 
-            // Reset variant at end of line
-            if (c == '\n'){
-                // Add a new vector for this chromosome if not in map
-                if (variants.count(variant.chromosome) == 0){
-                    variants.emplace(variant.chromosome, vector<Variant>());
-                }
+    buffers.write(this->vcf_index_path);
+    this->load_index();
+}
+
+
+void VCFReader::query(const string& chromosome, uint64_t start, uint64_t stop, const GenotypeHandler& f, const vector <uint16_t>& sample_numbers, size_t n_threads){
+    ///
+    /// Call f on every record of a chromosome whose reference allele overlaps [start, stop], in 1-based coordinates
+    /// like POS, with the genotypes of the selected samples. Only the chunks of text from the window of the start up
+    /// to the first record past the stop are read, which for a BGZF compressed VCF means only the blocks that overlap
+    /// the region are decompressed. The index is built on first use, with n_threads, if there is no current one. The
+    /// chromosome change handler is called as in next().
+    ///
+
+    if (not this->index){
+        if (std::experimental::filesystem::exists(this->vcf_index_path)){
+            cerr << "Index does not match VCF, regenerating .vcfi for " << this->vcf_path << " ... ";
+        }
+        else{
+            cerr << "No index found, generating .vcfi for " << this->vcf_path << " ... ";
+        }
+
+        this->build_index(n_threads);
+        cerr << "done\n";
+    }
 
-                variants.at(variant.chromosome).push_back(variant);
-                variant = {};
-                n_separators = 0;
+    this->current_chromosome.clear();
+
+    uint64_t offset;
+    if (not this->index->find_offset(chromosome, start - std::min(start, uint64_t(1)), offset)){
+        return;
+    }
+
+    vector <char> buffer;
+    string_view text;
+    string_view line;
+    Variant variant;
+    GenotypeMatrix genotypes(sample_numbers);
+    bool done = false;
+
+    while (not done and offset < this->text_size){
+        auto chunk_stop = this->find_line_end(std::min(this->text_size, offset + BYTES_PER_QUERY_CHUNK) - 1);
+        this->read_text(offset, chunk_stop, buffer, text);
+        offset = chunk_stop;
+
+        uint64_t cursor = 0;
+
+        while (not done and find_next_record(text, cursor, line)){
+            genotypes.clear();
+            parse_record(line, variant, genotypes);
+
+            if (variant.chromosome != chromosome or variant.reference_start > stop){
+                done = true;
+            }
+            else if (variant.reference_start + std::max(size_t(1), variant.alleles.at(0).size()) > start){
+                this->update_chromosome(variant.chromosome);
+                f(variant, genotypes, 0);
             }
         }
-        else {
-            token += c;
+    }
+
+    this->update_chromosome("");
+}
+
+
+void VCFReader::query(const string& chromosome, uint64_t start, uint64_t stop, const function<void(const Variant& variant)>& f, uint16_t sample_number, size_t n_threads){
+    this->query(chromosome, start, stop, [&](const Variant& variant, const GenotypeMatrix& genotypes, size_t record){
+        f(variant);
+    }, {sample_number}, n_threads);
+}
+
+
+void VCFReader::read_genotypes(vector <Variant>& variants, GenotypeMatrix& genotypes, size_t n_threads){
+    ///
+    /// Load every record in file order, and the genotypes of the samples selected in the matrix, in one pass
+    ///
+
+    variants.clear();
+    genotypes.clear();
+
+    this->for_each([&](const Variant& variant, const GenotypeMatrix& chunk_genotypes, size_t record){
+        variants.push_back(variant);
+        genotypes.append(chunk_genotypes, record);
+    }, genotypes.sample_numbers, n_threads);
+}
+
+
+void VCFReader::get_sample_names(vector <string>& names) const{
+    ///
+    /// Names of the samples, from the #CHROM header line. They are split on tabs, and also on spaces, which some
+    /// hand written VCFs use instead.
+    ///
+
+    names.clear();
+
+    vector <char> buffer;
+    string_view text;
+    uint64_t offset = 0;
+
+    while (offset < this->text_size){
+        auto stop = this->find_line_end(offset);
+        this->read_text(offset, stop, buffer, text);
+        offset = stop;
+
+        if (text.empty() or text[0] != '#'){
+            return;
         }
+
+        if (text.substr(0, 6) != "#CHROM"){
+            continue;
+        }
+
+        size_t column = 0;
+        size_t start = 0;
+
+        for (size_t i=0; i<=text.size(); i++){
+            if (i == text.size() or text[i] == '\t' or text[i] == ' ' or text[i] == '\n' or text[i] == '\r'){
+                if (i > start){
+                    if (column >= 9){
+                        names.emplace_back(text.substr(start, i - start));
+                    }
+                    column++;
+                }
+                start = i + 1;
+            }
+        }
+
+        return;
     }
 }
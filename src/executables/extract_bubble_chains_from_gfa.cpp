@@ -1,5 +1,7 @@
 #include "BubbleChain.hpp"
+#include "BubbleChainFinder.hpp"
 #include "GFAReader.hpp"
+#include "GFAStream.hpp"
 #include "boost/bimap.hpp"
 #include "boost/program_options.hpp"
 #include <iostream>
@@ -83,45 +85,90 @@ void extract_node_sets_from_assembly_summary(path assembly_summary_path, string_
 }
 
 
-void write_chain_segments_to_output_gfa(
-        BubbleChainComponent& chain_component,
+void write_all_chains_to_output_gfa(
+        vector <vector <BubbleChainComponent> >& chains,
         string_bimap& node_complements,
         GFAReader& gfa_reader,
-        string& gfa_line,
         ofstream& output_gfa){
 
-    // Write all the segments to a file
-    for (auto& segment: chain_component.segments) {
-        try {
-            gfa_reader.read_line(gfa_line, gfa_reader.sequence_line_indexes_by_node.at(segment));
-        }
-        catch (exception& e){
-            cerr << "Could not find node in GFA: " << segment << '\n';
-            throw e.what();
+    ///
+    /// Write the S line of every segment, in chain order. All of the lines are fetched in one batch, so the GFA is
+    /// read with a few large coalesced reads rather than one read per segment.
+    ///
+
+    vector <uint64_t> line_indexes;
+    NodeHandle handle;
+
+    for (auto& chain: chains){
+        for (auto& component: chain){
+            for (auto& segment: component.segments){
+                if (not gfa_reader.find_node_handle(segment, handle)){
+                    throw runtime_error("ERROR: could not find node in GFA: " + segment);
+                }
+
+                line_indexes.emplace_back(gfa_reader.get_sequence_line_index(handle));
+            }
         }
+    }
 
-        output_gfa << gfa_line;
+    GFALineBatch batch;
+    gfa_reader.read_lines(line_indexes, batch);
+
+    for (auto& line: batch.lines){
+        output_gfa << line;
     }
 }
 
 
-void write_all_chains_to_output_gfa(
+void write_all_chains_to_output_gfa_from_stream(
         vector <vector <BubbleChainComponent> >& chains,
-        string_bimap& node_complements,
-        GFAReader& gfa_reader,
+        unordered_set <string>& single_stranded_nodes,
+        path gfa_path,
         ofstream& output_gfa){
 
-    string line;
+    ///
+    /// Produce the same output as the indexed path, S lines in chain order followed by L lines in file order, with a
+    /// single sequential read of the GFA. Only the lines that belong in the output are kept in memory.
+    ///
+
+    unordered_map <string, string> sequence_lines_by_node;
+    string link_lines;
+
+    GFAStream gfa_stream(gfa_path);
+
+    gfa_stream.set_handler('S', [&](string_view line, const vector <string_view>& fields){
+        if (fields.size() > 1 and single_stranded_nodes.count(string(fields[1])) > 0){
+            // Like the index, only keep the first S line of a node
+            sequence_lines_by_node.emplace(string(fields[1]), string(line) + '\n');
+        }
+    });
+
+    gfa_stream.set_handler('L', [&](string_view line, const vector <string_view>& fields){
+        if (fields.size() > 3 and single_stranded_nodes.count(string(fields[1])) > 0 and single_stranded_nodes.count(string(fields[3])) > 0){
+            link_lines += line;
+            link_lines += '\n';
+        }
+    });
+
+    cerr << "Streaming GFA: " << gfa_path << " ... ";
+    gfa_stream.stream();
+    cerr << "done\n";
+
     for (auto& chain: chains){
         for (auto& component: chain){
-            write_chain_segments_to_output_gfa(
-                    component,
-                    node_complements,
-                    gfa_reader,
-                    line,
-                    output_gfa);
+            for (auto& segment: component.segments){
+                auto result = sequence_lines_by_node.find(segment);
+
+                if (result == sequence_lines_by_node.end()){
+                    throw runtime_error("ERROR: node not found in GFA: " + segment);
+                }
+
+                output_gfa << result->second;
+            }
         }
     }
+
+    output_gfa << link_lines;
 }
 
 
@@ -259,15 +306,14 @@ void read_bubble_chains_from_csv(
     }
 }
 
-void extract_bubble_chains_from_gfa(path gfa_path, path bubble_path, path assembly_summary_path, path output_dir){
-    create_directories(output_dir);
-    ifstream bubble_chain_file(bubble_path);
-
-    if (not bubble_chain_file.is_open()){
-        throw runtime_error("ERROR: could not open bubble chain file: " + bubble_path.string());
+void extract_bubble_chains_from_gfa(path gfa_path, path bubble_path, path assembly_summary_path, path output_dir, bool stream, bool detect, size_t max_bubble_size, size_t n_threads){
+    if (detect and stream){
+        throw runtime_error("ERROR: --detect requires the GFA index and cannot be combined with --stream");
     }
 
-    path output_path = gfa_path.filename();
+    create_directories(output_dir);
+
+    path output_path = (gfa_path == "-") ? path("stdin") : gfa_path.filename();
     output_path.replace_extension("bubble_chains.gfa");
     output_path = output_dir / output_path;
 
@@ -278,15 +324,51 @@ void extract_bubble_chains_from_gfa(path gfa_path, path bubble_path, path assemb
     }
 
     string_bimap node_complements;
-    extract_node_sets_from_assembly_summary(assembly_summary_path, node_complements);
+    vector <vector <BubbleChainComponent> > single_stranded_chains;
+    unordered_set <string> single_stranded_nodes;
+
+    // Detected chains are already reported on one strand, so no CSV or complement table is needed
+    if (detect){
+        GFAReader gfa_reader(gfa_path, n_threads);
+        BubbleChainFinder finder(gfa_reader, n_threads, max_bubble_size);
+        size_t n_abandoned_entrances;
+
+        cerr << "Finding bubble chains in GFA: " << gfa_path << " ... ";
+        finder.find_bubble_chains(single_stranded_chains, n_abandoned_entrances);
+        cerr << "done\n";
+
+        if (n_abandoned_entrances > 0){
+            cerr << "WARNING: search abandoned at " << n_abandoned_entrances << " candidate entrances after "
+                 << max_bubble_size << " nodes, bubbles larger than this are not reported, see --max_bubble_size\n";
+        }
+
+        for (auto& chain: single_stranded_chains){
+            for (auto& component: chain){
+                single_stranded_nodes.insert(component.segments.begin(), component.segments.end());
+            }
+        }
+
+        write_all_chains_to_output_gfa(
+                single_stranded_chains,
+                node_complements,
+                gfa_reader,
+                output_gfa);
 
-    GFAReader gfa_reader(gfa_path);
-    gfa_reader.map_sequences_by_node();
+        gfa_reader.write_link_subset_to_file(single_stranded_nodes, output_gfa);
+
+        return;
+    }
+
+    ifstream bubble_chain_file(bubble_path);
+
+    if (not bubble_chain_file.is_open()){
+        throw runtime_error("ERROR: could not open bubble chain file: " + bubble_path.string());
+    }
+
+    extract_node_sets_from_assembly_summary(assembly_summary_path, node_complements);
 
     vector <vector <BubbleChainComponent> > chains;
-    vector <vector <BubbleChainComponent> > single_stranded_chains;
     unordered_map <string, size_t> chain_indexes_by_node_ids;
-    unordered_set <string> single_stranded_nodes;
 
     read_bubble_chains_from_csv(
             bubble_chain_file,
@@ -301,6 +383,19 @@ void extract_bubble_chains_from_gfa(path gfa_path, path bubble_path, path assemb
             node_complements,
             single_stranded_nodes);
 
+    // The node set is known before the GFA is read, so it can be extracted without an index
+    if (stream){
+        write_all_chains_to_output_gfa_from_stream(
+                single_stranded_chains,
+                single_stranded_nodes,
+                gfa_path,
+                output_gfa);
+
+        return;
+    }
+
+    GFAReader gfa_reader(gfa_path, n_threads);
+
     write_all_chains_to_output_gfa(
             single_stranded_chains,
             node_complements,
@@ -316,13 +411,17 @@ int main(int argc, char* argv[]){
     path bubble_path;
     path assembly_summary_path;
     path output_dir;
+    bool stream;
+    bool detect;
+    size_t max_bubble_size;
+    size_t n_threads;
 
     options_description options("Arguments");
 
     options.add_options()
             ("gfa",
              value<path>(&gfa_path),
-             "File path of GFA file containing shasta assembly graph")
+             "File path of GFA file containing shasta assembly graph, or - for stdin (with --stream)")
 
             ("bubbles",
              value<path>(&bubble_path),
@@ -335,7 +434,31 @@ int main(int argc, char* argv[]){
             ("output_dir",
              value<path>(&output_dir)->
              default_value("output/"),
-             "Destination directory. File will be named based on input file name");
+             "Destination directory. File will be named based on input file name")
+
+            ("stream",
+             value<bool>(&stream)->
+             default_value(false)->
+             implicit_value(true),
+             "Read the GFA in one sequential pass instead of indexing it. No .gfai is written, so this works for "
+             "read-only locations, pipes and stdin. Plain, gzip and BGZF GFAs are accepted")
+
+            ("detect",
+             value<bool>(&detect)->
+             default_value(false)->
+             implicit_value(true),
+             "Find the bubble chains directly from the GFA topology, so --bubbles and --summary are not needed")
+
+            ("max_bubble_size",
+             value<size_t>(&max_bubble_size)->
+             default_value(BubbleChainFinder::DEFAULT_MAX_BUBBLE_SIZE),
+             "With --detect, the number of nodes after which the search for a bubble from one entrance gives up, or 0 "
+             "for no limit. Bubbles larger than this are not reported, and the number of searches abandoned is printed")
+
+            ("threads",
+             value<size_t>(&n_threads)->
+             default_value(1),
+             "Maximum number of threads to use when indexing the GFA and detecting bubbles");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -352,7 +475,11 @@ int main(int argc, char* argv[]){
             gfa_path,
             bubble_path,
             assembly_summary_path,
-            output_dir);
+            output_dir,
+            stream,
+            detect,
+            max_bubble_size,
+            n_threads);
 
     return 0;
 }
@@ -0,0 +1,206 @@
+#include "GFAReader.hpp"
+#include "vg/vg.pb.h"
+#include "vg/io/protobuf_iterator.hpp"
+#include "boost/program_options.hpp"
+#include <iostream>
+#include <chrono>
+#include <stdexcept>
+#include <unordered_set>
+
+using std::cout;
+using std::cerr;
+using std::ifstream;
+using std::ofstream;
+using std::runtime_error;
+using std::unordered_set;
+using std::experimental::filesystem::path;
+using boost::program_options::options_description;
+using boost::program_options::variables_map;
+using boost::program_options::value;
+using vg::Alignment;
+
+
+void split_comma_separated(const string& s, vector <string>& tokens){
+    string token;
+
+    for (auto& c: s){
+        if (c == ','){
+            if (not token.empty()){
+                tokens.emplace_back(token);
+            }
+            token.resize(0);
+        }
+        else{
+            token += c;
+        }
+    }
+
+    if (not token.empty()){
+        tokens.emplace_back(token);
+    }
+}
+
+
+void get_seeds_from_gam(GFAReader& gfa_reader, path gam_path, const vector <string>& read_names, vector <NodeHandle>& seeds){
+    ///
+    /// Use every node on the path of the named alignments as a seed, or of all alignments if no names are given
+    ///
+
+    ifstream gam_file(gam_path);
+
+    if (not gam_file.is_open()){
+        throw runtime_error("ERROR: could not open GAM file: " + gam_path.string());
+    }
+
+    unordered_set <string> names(read_names.begin(), read_names.end());
+    unordered_set <string> found_names;
+
+    for (vg::io::ProtobufIterator<Alignment> it(gam_file); it.has_current(); it.advance()) {
+        Alignment& alignment = *it;
+
+        if (not names.empty() and names.count(alignment.name()) == 0){
+            continue;
+        }
+
+        found_names.insert(alignment.name());
+
+        for (auto& mapping: alignment.path().mapping()){
+            seeds.emplace_back(gfa_reader.get_node_handle(int64_t(mapping.position().node_id())));
+        }
+    }
+
+    for (auto& name: names){
+        if (found_names.count(name) == 0){
+            cerr << "WARNING: read not found in GAM: " << name << '\n';
+        }
+    }
+}
+
+
+void extract_neighborhood_from_gfa(
+        path gfa_path,
+        path output_path,
+        string node_names,
+        path gam_path,
+        string read_names,
+        uint64_t max_hops,
+        uint64_t max_distance,
+        size_t n_threads){
+
+    GFAReader gfa_reader(gfa_path, n_threads);
+
+    vector <NodeHandle> seeds;
+    vector <string> names;
+
+    split_comma_separated(node_names, names);
+    for (auto& name: names){
+        seeds.emplace_back(gfa_reader.get_node_handle(name));
+    }
+
+    if (not gam_path.empty()){
+        names.clear();
+        split_comma_separated(read_names, names);
+        get_seeds_from_gam(gfa_reader, gam_path, names, seeds);
+    }
+
+    if (seeds.empty()){
+        throw runtime_error("ERROR: no seed nodes found, provide --nodes or --gam");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+
+    vector <NodeHandle> neighborhood;
+    gfa_reader.get_neighborhood(seeds, max_hops, max_distance, neighborhood);
+
+    ofstream output_file(output_path);
+
+    if (not output_file.is_open()){
+        throw runtime_error("ERROR: could not write file: " + output_path.string());
+    }
+
+    gfa_reader.write_subgraph_to_file(neighborhood, output_file);
+
+    auto stop = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
+
+    cerr << "Extracted " << neighborhood.size() << " nodes around " << seeds.size() << " seeds in " << double(elapsed)/1000 << " ms\n";
+}
+
+
+int main(int argc, char* argv[]){
+    path gfa_path;
+    path output_path;
+    string node_names;
+    path gam_path;
+    string read_names;
+    uint64_t max_hops;
+    uint64_t max_distance;
+    size_t n_threads;
+
+    options_description options("Arguments");
+
+    options.add_options()
+            ("gfa",
+             value<path>(&gfa_path),
+             "File path of GFA file to extract the neighborhood from")
+
+            ("output",
+             value<path>(&output_path)->
+             default_value("neighborhood.gfa"),
+             "File path of the GFA to write, containing the neighborhood's S lines and the L lines between them")
+
+            ("nodes",
+             value<string>(&node_names),
+             "Comma separated names of the nodes to use as seeds")
+
+            ("gam",
+             value<path>(&gam_path),
+             "Optional: GAM file whose alignment paths are used as seeds")
+
+            ("reads",
+             value<string>(&read_names),
+             "Comma separated names of the alignments in the GAM to use as seeds. If omitted, all alignments are used")
+
+            ("hops",
+             value<uint64_t>(&max_hops)->
+             default_value(GFAReader::NO_LIMIT, "unlimited"),
+             "Maximum number of links between a seed and a node in the neighborhood")
+
+            ("radius",
+             value<uint64_t>(&max_distance)->
+             default_value(GFAReader::NO_LIMIT, "unlimited"),
+             "Maximum number of bases between a seed and a node in the neighborhood (seeds are not counted)")
+
+            ("threads",
+             value<size_t>(&n_threads)->
+             default_value(1),
+             "Maximum number of threads to use when indexing the GFA");
+
+    // Store options in a map and apply values to each corresponding variable
+    variables_map vm;
+    store(parse_command_line(argc, argv, options), vm);
+    notify(vm);
+
+    // If help was specified, or no arguments given, provide help
+    if (vm.count("help") || argc == 1) {
+        cout << options << "\n";
+        return 0;
+    }
+
+    // Without any limit the neighborhood would be the whole connected component
+    if (vm["hops"].defaulted() and vm["radius"].defaulted()){
+        throw runtime_error("ERROR: at least one of --hops or --radius must be given");
+    }
+
+    extract_neighborhood_from_gfa(
+            gfa_path,
+            output_path,
+            node_names,
+            gam_path,
+            read_names,
+            max_hops,
+            max_distance,
+            n_threads);
+
+    return 0;
+}
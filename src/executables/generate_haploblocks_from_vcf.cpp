@@ -1,8 +1,11 @@
 #include "VCFReader.hpp"
 #include "FastaReaderLite.hpp"
 #include "boost/program_options.hpp"
+#include <unordered_map>
 #include <iostream>
+#include <fstream>
 #include <cmath>
+#include <limits>
 #include <stdexcept>
 
 using std::cout;
@@ -11,6 +14,7 @@ using std::min;
 using std::max;
 using std::ofstream;
 using std::runtime_error;
+using std::unordered_map;
 using std::to_string;
 using std::experimental::filesystem::create_directories;
 using boost::program_options::options_description;
@@ -18,17 +22,173 @@ using boost::program_options::variables_map;
 using boost::program_options::value;
 
 
-void generate_haploblocks_from_vcf(path ref_fasta_path, path vcf_path, uint16_t sample_number, uint32_t flank_size, path output_dir){
-    path output_filename = "haploblocks.fasta";
-    path output_fasta_path = absolute(output_dir) / output_filename;
+void parse_region(const string& region, string& chromosome, uint64_t& start, uint64_t& stop){
+    ///
+    /// Parse a region of the form chr, chr:start or chr:start-stop, with 1-based inclusive coordinates like samtools
+    ///
+
+    start = 1;
+    stop = std::numeric_limits<uint64_t>::max();
+
+    auto colon = region.rfind(':');
+    chromosome = region.substr(0, colon);
+
+    if (colon == string::npos){
+        return;
+    }
+
+    try {
+        auto dash = region.find('-', colon);
+        start = std::stoull(region.substr(colon + 1, dash - colon - 1));
+
+        if (dash != string::npos){
+            stop = std::stoull(region.substr(dash + 1));
+        }
+    }
+    catch (std::logic_error& e){
+        throw runtime_error("ERROR: could not parse region: " + region);
+    }
+
+    if (chromosome.empty() or start == 0 or stop < start){
+        throw runtime_error("ERROR: invalid region: " + region);
+    }
+}
+
+
+void split_comma_separated(const string& s, vector <string>& tokens){
+    string token;
+
+    for (auto& c: s){
+        if (c == ','){
+            if (not token.empty()){
+                tokens.emplace_back(token);
+            }
+            token.resize(0);
+        }
+        else{
+            token += c;
+        }
+    }
+
+    if (not token.empty()){
+        tokens.emplace_back(token);
+    }
+}
+
+
+void parse_sample_numbers(const string& samples, size_t n_samples, vector <uint16_t>& sample_numbers){
+    ///
+    /// Parse a comma separated list of sample numbers, e.g. 0,3,4, or "all"
+    ///
+
+    sample_numbers.clear();
+
+    if (samples == "all"){
+        for (size_t i=0; i<n_samples; i++){
+            sample_numbers.emplace_back(uint16_t(i));
+        }
+        return;
+    }
+
+    vector <string> tokens;
+    split_comma_separated(samples, tokens);
+
+    for (auto& token: tokens){
+        size_t n;
+
+        try {
+            n = std::stoul(token);
+        }
+        catch (std::logic_error& e){
+            throw runtime_error("ERROR: could not parse sample number: " + token);
+        }
+
+        if (n >= n_samples){
+            throw runtime_error("ERROR: sample number " + token + " is out of range, the VCF has " + to_string(n_samples) + " samples");
+        }
+
+        sample_numbers.emplace_back(uint16_t(n));
+    }
+}
+
+
+void write_haploblocks(ofstream& output_fasta, const string& sequence, const Variant& variant, uint8_t allele_0, uint8_t allele_1, uint32_t flank_size){
+    int64_t left_flank_start = 0;
+    int64_t right_flank_start = 0;
+    int64_t right_flank_size = 0;
+
+    if (allele_0 >= variant.alleles.size() or allele_1 >= variant.alleles.size()){
+        throw runtime_error("ERROR: genotype refers to a missing allele at " + variant.chromosome + ':' + to_string(variant.reference_start));
+    }
+
+    // Haplotype 0
+    left_flank_start = variant.reference_start - flank_size - 1;
+    left_flank_start = max(int64_t(0), left_flank_start);
+    right_flank_start = variant.reference_start - 1 + variant.alleles[0].size();
+    right_flank_start = min(int64_t(sequence.size()), right_flank_start);
+    right_flank_size = min(int64_t(sequence.size() - right_flank_start), int64_t(flank_size));
+
+    output_fasta << '>' << variant.chromosome << '_' << to_string(variant.reference_start) << "_h0_" << variant.alleles[allele_0].size() << '\n';
+    output_fasta << sequence.substr(left_flank_start,variant.reference_start - left_flank_start - 1)
+                 << variant.alleles[allele_0]
+                 << sequence.substr(right_flank_start,right_flank_size) << '\n';
+
+    // Haplotype 1
+    left_flank_start = variant.reference_start - flank_size - 1;
+    left_flank_start = max(int64_t(0), left_flank_start);
+    right_flank_start = variant.reference_start - 1 + variant.alleles[0].size();
+    right_flank_start = min(int64_t(sequence.size() - 1), right_flank_start);
+    right_flank_size = min(int64_t(sequence.size() - right_flank_start), int64_t(flank_size));
+
+    output_fasta << '>' << variant.chromosome << '_' << to_string(variant.reference_start) << "_h1_" << variant.alleles[allele_1].size() << '\n';
+    output_fasta << sequence.substr(left_flank_start,variant.reference_start - left_flank_start - 1);
+    output_fasta << variant.alleles[allele_1];
+    output_fasta << sequence.substr(right_flank_start,right_flank_size) << '\n';
+}
+
+
+void generate_haploblocks_from_vcf(
+        path ref_fasta_path,
+        path vcf_path,
+        uint16_t sample_number,
+        const string& samples,
+        uint32_t flank_size,
+        path output_dir,
+        size_t n_threads,
+        const string& region){
+    ///
+    /// Write the haploblocks of one sample to haploblocks.fasta, or with `samples`, those of each selected sample to
+    /// its own haploblocks_<sample name>.fasta. The reference and the VCF are read once for all samples.
+    ///
+
     create_directories(output_dir);
 
-    ofstream output_fasta(output_fasta_path);
+    VCFReader vcf_reader(vcf_path);
+
+    vector <uint16_t> sample_numbers = {sample_number};
+    vector <path> output_fasta_paths = {absolute(output_dir) / "haploblocks.fasta"};
+
+    if (not samples.empty()){
+        vector <string> sample_names;
+        vcf_reader.get_sample_names(sample_names);
+        parse_sample_numbers(samples, sample_names.size(), sample_numbers);
+
+        output_fasta_paths.clear();
+        for (auto n: sample_numbers){
+            output_fasta_paths.emplace_back(absolute(output_dir) / ("haploblocks_" + sample_names[n] + ".fasta"));
+        }
+    }
+
+    vector <ofstream> output_fastas(output_fasta_paths.size());
+
+    for (size_t i=0; i<output_fastas.size(); i++){
+        output_fastas[i].open(output_fasta_paths[i]);
 
-    if (not output_fasta.is_open()){
-        throw runtime_error("ERROR: could not create output file: " + output_fasta_path.string());
+        if (not output_fastas[i].is_open()){
+            throw runtime_error("ERROR: could not create output file: " + output_fasta_paths[i].string());
+        }
+        cerr << "Writing to " << output_fasta_paths[i] << '\n';
     }
-    cerr << "Writing to " << output_fasta_path << '\n';
 
     cerr << "Reading Fasta...\n";
     FastaReaderLite fasta_reader(ref_fasta_path);
@@ -36,48 +196,64 @@ void generate_haploblocks_from_vcf(path ref_fasta_path, path vcf_path, uint16_t
     vector <pair <string,string> > sequences;
     fasta_reader.read_all(sequences);
 
+    // Sequences are looked up by name once per chromosome of the VCF
+    unordered_map <string, size_t> sequence_indexes;
+    for (size_t i=0; i<sequences.size(); i++){
+        sequence_indexes.emplace(sequences[i].first, i);
+    }
+
     cerr << "Reading VCF...\n";
-    VCFReader vcf_reader(vcf_path);
+    const string* sequence_pointer = nullptr;
+    vector <bool> has_variants(sequences.size(), false);
+
+    vcf_reader.set_chromosome_change_handler([&](const string& previous_chromosome, const string& next_chromosome){
+        if (next_chromosome.empty()){
+            return;
+        }
 
-    map <string, vector <Variant> > variants;
-    vcf_reader.read_all(variants, sample_number);
+        auto result = sequence_indexes.find(next_chromosome);
 
-    int64_t left_flank_start = 0;
-    int64_t right_flank_start = 0;
-    int64_t right_flank_size = 0;
+        if (result == sequence_indexes.end()){
+            cerr << "WARNING: chromosome not found in reference: " << next_chromosome << '\n';
+            sequence_pointer = nullptr;
+        }
+        else{
+            sequence_pointer = &sequences[result->second].second;
+            has_variants[result->second] = true;
+        }
+    });
 
     cerr << "Generating Haploblocks...\n";
-    for (auto& [chromosome_name, sequence]: sequences) {
-        if (variants.count(chromosome_name) == 0){
-            cout << "Skipping " << chromosome_name << '\n';
-            continue;
+
+    auto write_all_haploblocks = [&](const Variant& variant, const GenotypeMatrix& genotypes, size_t record){
+        if (sequence_pointer == nullptr){
+            return;
         }
 
-        for (auto& variant: variants.at(chromosome_name)) {
-            // Haplotype 0
-            left_flank_start = variant.reference_start - flank_size - 1;
-            left_flank_start = max(int64_t(0), left_flank_start);
-            right_flank_start = variant.reference_start - 1 + variant.alleles[0].size();
-            right_flank_start = min(int64_t(sequence.size()), right_flank_start);
-            right_flank_size = min(int64_t(sequence.size() - right_flank_start), int64_t(flank_size));
-
-            output_fasta << '>' << variant.chromosome << '_' << to_string(variant.reference_start) << "_h0_" << variant.alleles[variant.genotype.first].size() << '\n';
-            output_fasta << sequence.substr(left_flank_start,variant.reference_start - left_flank_start - 1)
-                         << variant.alleles[variant.genotype.first]
-                         << sequence.substr(right_flank_start,right_flank_size) << '\n';
-
-            // Haplotype 1
-            left_flank_start = variant.reference_start - flank_size - 1;
-            left_flank_start = max(int64_t(0), left_flank_start);
-            right_flank_start = variant.reference_start - 1 + variant.alleles[0].size();
-            right_flank_start = min(int64_t(sequence.size() - 1), right_flank_start);
-            right_flank_size = min(int64_t(sequence.size() - right_flank_start), int64_t(flank_size));
-
-            output_fasta << '>' << variant.chromosome << '_' << to_string(variant.reference_start) << "_h1_" << variant.alleles[variant.genotype.second].size() << '\n';
-            output_fasta << sequence.substr(left_flank_start,variant.reference_start - left_flank_start - 1);
-            output_fasta << variant.alleles[variant.genotype.second];
-            output_fasta << sequence.substr(right_flank_start,right_flank_size) << '\n';
+        for (size_t s=0; s<genotypes.get_sample_count(); s++){
+            auto allele_0 = genotypes.get_allele(record, s, 0);
+            auto allele_1 = genotypes.get_allele(record, s, 1);
+            write_haploblocks(output_fastas[s], *sequence_pointer, variant, allele_0, allele_1, flank_size);
+        }
+    };
+
+    if (not region.empty()){
+        string chromosome;
+        uint64_t start;
+        uint64_t stop;
+        parse_region(region, chromosome, start, stop);
+
+        // Only the part of the VCF that overlaps the region is read, using the .vcfi
+        vcf_reader.query(chromosome, start, stop, write_all_haploblocks, sample_numbers, n_threads);
+        return;
+    }
+
+    // Variants are streamed in the order of the VCF, so only one batch of chunks is in memory at a time
+    vcf_reader.for_each(write_all_haploblocks, sample_numbers, n_threads);
 
+    for (size_t i=0; i<sequences.size(); i++){
+        if (not has_variants[i]){
+            cout << "Skipping " << sequences[i].first << '\n';
         }
     }
 }
@@ -89,6 +265,9 @@ int main(int argc, char* argv[]){
     path output_dir;
     uint32_t flank_size;
     uint16_t sample_number;
+    string samples;
+    size_t n_threads;
+    string region;
 
     options_description options("Arguments");
 
@@ -114,7 +293,25 @@ int main(int argc, char* argv[]){
             ("sample",
              value<uint16_t>(&sample_number)->
              default_value(0),
-             "The number of the sample (in order of appearance) to use for generating haploblocks, STARTING FROM 0");
+             "The number of the sample (in order of appearance) to use for generating haploblocks, STARTING FROM 0")
+
+            ("samples",
+             value<string>(&samples)->
+             default_value(""),
+             "Comma separated numbers of samples (as for --sample), or 'all', to generate haploblocks for in one pass, "
+             "each written to haploblocks_<sample name>.fasta. Overrides --sample")
+
+            ("threads",
+             value<size_t>(&n_threads)->
+             default_value(1),
+             "Maximum number of threads to use when parsing the VCF")
+
+            ("region",
+             value<string>(&region)->
+             default_value(""),
+             "Only generate haploblocks for variants overlapping this region, given as chr, chr:start or chr:start-stop "
+             "(1-based, inclusive). The VCF may be BGZF compressed, and must be sorted. An index (.vcfi) is written next "
+             "to it on first use");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -131,8 +328,11 @@ int main(int argc, char* argv[]){
             ref_fasta_path,
             vcf_path,
             sample_number,
+            samples,
             flank_size,
-            output_dir);
+            output_dir,
+            n_threads,
+            region);
 
     return 0;
 }
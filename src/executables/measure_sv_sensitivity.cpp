@@ -1,4 +1,5 @@
 #include "BubbleChain.hpp"
+#include "BubbleChainFinder.hpp"
 #include "GFAReader.hpp"
 #include "vg/vg.pb.h"
 #include "vg/io/protobuf_iterator.hpp"
@@ -15,6 +16,7 @@ using std::cerr;
 using std::stoi;
 using std::to_string;
 using std::unordered_set;
+using std::unordered_map;
 using std::runtime_error;
 using std::experimental::filesystem::path;
 using std::experimental::filesystem::create_directories;
@@ -105,26 +107,52 @@ void extract_haplotype_info_from_read_name(string& read_name, uint64_t& haplotyp
 }
 
 
-void measure_sv_sensitivity(path gfa_path, path gam_path, path bubble_path, path assembly_summary_path, path output_dir){
-    GFAReader gfa_reader(gfa_path);
-    gfa_reader.map_sequences_by_node();
-    gfa_reader.map_links_by_node();
+void read_subgraph_manifest(path manifest_path, path output_dir, unordered_map <string, vector <size_t> >& subgraphs_by_read, vector <path>& subgraph_paths){
+    ///
+    /// Parse a manifest of subgraphs to extract, with one tab separated line per subgraph:
+    ///     read_name   output_path
+    /// Relative output paths are placed in the output directory. A read may be listed more than once.
+    ///
 
-    create_directories(output_dir);
-    ifstream bubble_chain_file(bubble_path);
-    ifstream gam_file(gam_path);
+    ifstream manifest(manifest_path);
 
-    if (not bubble_chain_file.is_open()){
-        throw runtime_error("ERROR: could not open bubble chain file: " + bubble_path.string());
+    if (not manifest.is_open()){
+        throw runtime_error("ERROR: could not open subgraph manifest: " + manifest_path.string());
     }
 
-    if (not gam_file.is_open()){
-        throw runtime_error("ERROR: could not open bubble chain file: " + bubble_path.string());
+    string line;
+    uint64_t l = 0;
+    while (getline(manifest, line)){
+        if (line.empty()){
+            l++;
+            continue;
+        }
+
+        auto separator = line.find('\t');
+
+        if (separator == string::npos or separator == 0 or separator == line.size() - 1){
+            throw runtime_error("ERROR: expected read name and output path at line " + std::to_string(l) + " of " + manifest_path.string());
+        }
+
+        path subgraph_path = line.substr(separator + 1);
+        if (subgraph_path.is_relative()){
+            subgraph_path = output_dir / subgraph_path;
+        }
+
+        subgraphs_by_read[line.substr(0, separator)].emplace_back(subgraph_paths.size());
+        subgraph_paths.emplace_back(subgraph_path);
+
+        l++;
     }
+}
 
-    path output_path = output_dir / ("bubble_stats_" + gam_path.filename().string());
-    output_path.replace_extension("csv");
-    ofstream output_file(output_path);
+
+void find_bubble_nodes_from_csv(path bubble_path, path assembly_summary_path, unordered_set <string>& bubble_nodes){
+    ifstream bubble_chain_file(bubble_path);
+
+    if (not bubble_chain_file.is_open()){
+        throw runtime_error("ERROR: could not open bubble chain file: " + bubble_path.string());
+    }
 
     string_bimap node_complements;
     extract_node_sets_from_assembly_summary(assembly_summary_path, node_complements);
@@ -140,8 +168,6 @@ void measure_sv_sensitivity(path gfa_path, path gam_path, path bubble_path, path
     ///     Chain,Circular,Position,Segment0,Segment1,Segment2,Segment3,Segment4,
     ///
     string gfa_line;
-    string node_name;
-    unordered_set <string> is_bubble;
     vector <BubbleChainComponent> chain;
     while (getline(bubble_chain_file, line)){
         // Skip header line
@@ -160,15 +186,15 @@ void measure_sv_sensitivity(path gfa_path, path gam_path, path bubble_path, path
 
         if (chain_component.segments.size() > 1){
             for (auto& segment: chain_component.segments) {
-                is_bubble.insert(segment);
+                bubble_nodes.insert(segment);
 
                 auto forward_complement = node_complements.left.find(segment);
                 auto reverse_complement = node_complements.right.find(segment);
                 if (forward_complement != node_complements.left.end()) {
-                    is_bubble.insert(forward_complement->get_right());
+                    bubble_nodes.insert(forward_complement->get_right());
                 }
                 else if (reverse_complement != node_complements.right.end()) {
-                    is_bubble.insert(reverse_complement->get_left());
+                    bubble_nodes.insert(reverse_complement->get_left());
                 }
             }
         }
@@ -181,8 +207,75 @@ void measure_sv_sensitivity(path gfa_path, path gam_path, path bubble_path, path
         }
 
     }
+}
+
+
+void measure_sv_sensitivity(path gfa_path, path gam_path, path bubble_path, path assembly_summary_path, path output_dir, path subgraph_manifest_path, bool detect, size_t max_bubble_size, size_t n_threads){
+    GFAReader gfa_reader(gfa_path, n_threads);
 
-    node_complements.clear();
+    create_directories(output_dir);
+    ifstream gam_file(gam_path);
+
+    if (not gam_file.is_open()){
+        throw runtime_error("ERROR: could not open GAM file: " + gam_path.string());
+    }
+
+    path output_path = output_dir / ("bubble_stats_" + gam_path.filename().string());
+    output_path.replace_extension("csv");
+    ofstream output_file(output_path);
+
+    // Subgraphs are collected during the alignment loop and written together at the end, in one pass over the GFA
+    unordered_map <string, vector <size_t> > subgraphs_by_read;
+    vector <path> subgraph_paths;
+
+    if (not subgraph_manifest_path.empty()){
+        read_subgraph_manifest(subgraph_manifest_path, output_dir, subgraphs_by_read, subgraph_paths);
+    }
+
+    vector <vector <NodeHandle> > subgraph_nodes(subgraph_paths.size());
+
+    string line;
+    unordered_set <string> bubble_nodes;
+
+    // Detection sees every segment in the GFA, so with a BothStrands assembly the chains of both strands are found
+    // and no complement lookup is needed
+    if (detect){
+        vector <vector <BubbleChainComponent> > chains;
+        BubbleChainFinder finder(gfa_reader, n_threads, max_bubble_size);
+        size_t n_abandoned_entrances;
+
+        cerr << "Finding bubble chains in GFA: " << gfa_path << " ... ";
+        finder.find_bubble_chains(chains, n_abandoned_entrances);
+        cerr << "done\n";
+
+        if (n_abandoned_entrances > 0){
+            cerr << "WARNING: " << n_abandoned_entrances << " bubble searches stopped at --max_bubble_size "
+                 << max_bubble_size << ", reads in larger bubbles are counted as outside of bubbles\n";
+        }
+
+        for (auto& chain: chains){
+            for (auto& component: chain){
+                if (component.segments.size() > 1){
+                    bubble_nodes.insert(component.segments.begin(), component.segments.end());
+                }
+            }
+        }
+    }
+    else{
+        find_bubble_nodes_from_csv(bubble_path, assembly_summary_path, bubble_nodes);
+    }
+
+    // Resolve bubble membership to node handles once, so that the alignment loop never hashes a node name
+    vector <bool> is_bubble(gfa_reader.get_node_count(), false);
+    NodeHandle handle;
+
+    for (auto& name: bubble_nodes){
+        if (gfa_reader.find_node_handle(name, handle)){
+            is_bubble[handle] = true;
+        }
+    }
+
+    bubble_nodes.clear();
 
     string read_name;
     uint64_t haplotype = 0;
@@ -191,14 +284,13 @@ void measure_sv_sensitivity(path gfa_path, path gam_path, path bubble_path, path
     uint64_t total_bubble_length = 0;
     bool alignment_in_bubble;
     ifstream datastream(gam_path);
-    unordered_set<string> nodes_in_alignment;
+    unordered_set<NodeHandle> nodes_in_alignment;
 
     for (vg::io::ProtobufIterator<Alignment> it(datastream); it.has_current(); it.advance()) {
         Alignment& alignment = *it;
         read_name = alignment.name();
 
         nodes_in_alignment.clear();
-        node_name.resize(0);
 
         total_bubble_length = 0;
         n_bubbles = 0;
@@ -206,19 +298,17 @@ void measure_sv_sensitivity(path gfa_path, path gam_path, path bubble_path, path
         cout << "\nName: " << read_name << '\n';
 
         for (auto& mapping: alignment.path().mapping()){
-            node_name = to_string(mapping.position().node_id());
-            nodes_in_alignment.insert(node_name);
+            handle = gfa_reader.get_node_handle(int64_t(mapping.position().node_id()));
+            nodes_in_alignment.insert(handle);
 
-            alignment_in_bubble = (is_bubble.find(node_name) != is_bubble.end());
+            alignment_in_bubble = is_bubble[handle];
 
-            cout << "Segment: " << node_name << '\n';
+            cout << "Segment: " << mapping.position().node_id() << '\n';
             cout << "Is bubble: " << alignment_in_bubble << '\n';
-            cout << "Is bubble??: " << (is_bubble.count(node_name) > 0) << '\n';
-            cout << "Is bubble??: " << (is_bubble.find(node_name) != is_bubble.end()) << '\n';
 
             if (alignment_in_bubble){
                 n_bubbles++;
-                total_bubble_length += gfa_reader.get_sequence_length(node_name);
+                total_bubble_length += gfa_reader.get_sequence_length(handle);
             }
         }
 
@@ -228,12 +318,17 @@ void measure_sv_sensitivity(path gfa_path, path gam_path, path bubble_path, path
             output_file << read_name << "," << n_bubbles << "," << haplotype_length << "," << total_bubble_length << '\n';
         }
 
-        if (read_name == "chr14_85915451_h0_1") {
-            path subgraph_path = output_dir / (read_name + "_subgraph.gfa");
-            ofstream subgraph_gfa_file(subgraph_path);
-            gfa_reader.write_subgraph_to_file(nodes_in_alignment, subgraph_gfa_file);
+        auto result = subgraphs_by_read.find(read_name);
+        if (result != subgraphs_by_read.end()){
+            for (auto& i: result->second){
+                subgraph_nodes[i].insert(subgraph_nodes[i].end(), nodes_in_alignment.begin(), nodes_in_alignment.end());
+            }
         }
     }
+
+    if (not subgraph_paths.empty()){
+        gfa_reader.write_subgraphs_to_files(subgraph_nodes, subgraph_paths);
+    }
 }
 
 
@@ -243,6 +338,10 @@ int main(int argc, char* argv[]){
     path bubble_path;
     path assembly_summary_path;
     path output_dir;
+    path subgraph_manifest_path;
+    bool detect;
+    size_t max_bubble_size;
+    size_t n_threads;
 
     options_description options("Arguments");
 
@@ -266,7 +365,29 @@ int main(int argc, char* argv[]){
             ("output_dir",
              value<path>(&output_dir)->
              default_value("output/"),
-             "Destination directory. File will be named based on input file name");
+             "Destination directory. File will be named based on input file name")
+
+            ("subgraph_manifest",
+             value<path>(&subgraph_manifest_path),
+             "Optional: tab separated file of read name and output GFA path. The subgraph of the nodes that each read "
+             "aligns to is written to its path, all in one pass over the GFA. Relative paths are in the output directory")
+
+            ("detect",
+             value<bool>(&detect)->
+             default_value(false)->
+             implicit_value(true),
+             "Find the bubbles directly from the GFA topology, so --bubbles and --summary are not needed")
+
+            ("max_bubble_size",
+             value<size_t>(&max_bubble_size)->
+             default_value(BubbleChainFinder::DEFAULT_MAX_BUBBLE_SIZE),
+             "With --detect, the number of nodes after which the search for a bubble from one entrance gives up, or 0 "
+             "for no limit. Bubbles larger than this are not reported, and the number of searches abandoned is printed")
+
+            ("threads",
+             value<size_t>(&n_threads)->
+             default_value(1),
+             "Maximum number of threads to use when indexing the GFA");
 
     // Store options in a map and apply values to each corresponding variable
     variables_map vm;
@@ -284,7 +405,11 @@ int main(int argc, char* argv[]){
             gam_path,
             bubble_path,
             assembly_summary_path,
-            output_dir);
+            output_dir,
+            subgraph_manifest_path,
+            detect,
+            max_bubble_size,
+            n_threads);
 
     return 0;
 }
@@ -0,0 +1,77 @@
+#include "GFAOverlapValidator.hpp"
+#include "boost/program_options.hpp"
+#include <iostream>
+
+using std::cout;
+using std::cerr;
+using std::experimental::filesystem::path;
+using boost::program_options::options_description;
+using boost::program_options::variables_map;
+using boost::program_options::value;
+
+
+void validate_gfa_overlaps(path gfa_path, size_t n_threads){
+    ///
+    /// Print every link whose overlap does not match its segments, in the same format as
+    /// scripts/test_gfa_overlaps.py, followed by a summary over all links
+    ///
+
+    GFAReader gfa_reader(gfa_path, n_threads);
+    GFAOverlapValidator validator(gfa_reader, n_threads);
+
+    CigarStats total_true_stats;
+    CigarStats total_gfa_stats;
+    uint64_t n_invalid_links = 0;
+
+    validator.validate([&](const OverlapValidation& result){
+        cout << result.node_a << '\t' << result.node_b << '\n';
+        cout << result.get_link_string() << '\n';
+        cout << result.true_stats.to_string() << '\n';
+        cout << result.gfa_stats.to_string() << '\n';
+        cout << result.alignment << '\n';
+        cout << result.warning << "ERROR: mismatch found in alignment" << '\n';
+        cout << '\n';
+
+        n_invalid_links++;
+    }, total_true_stats, total_gfa_stats);
+
+    auto n_links = gfa_reader.line_indexes_by_type.count('L') ? gfa_reader.line_indexes_by_type.at('L').size() : 0;
+
+    cerr << "Links checked: " << n_links << '\n';
+    cerr << "Links with errors: " << n_invalid_links << '\n';
+    cerr << "True stats (matches, mismatches, inserts, deletes):\t" << total_true_stats.to_string() << '\n';
+    cerr << "GFA stats (matches, mismatches, inserts, deletes):\t" << total_gfa_stats.to_string() << '\n';
+}
+
+
+int main(int argc, char* argv[]){
+    path gfa_path;
+    size_t n_threads;
+
+    options_description options("Arguments");
+
+    options.add_options()
+            ("gfa",
+             value<path>(&gfa_path),
+             "File path of GFA file whose link overlaps should be checked against its segment sequences")
+
+            ("threads",
+             value<size_t>(&n_threads)->
+             default_value(1),
+             "Maximum number of threads to use when indexing and validating the GFA");
+
+    // Store options in a map and apply values to each corresponding variable
+    variables_map vm;
+    store(parse_command_line(argc, argv, options), vm);
+    notify(vm);
+
+    // If help was specified, or no arguments given, provide help
+    if (vm.count("help") || argc == 1) {
+        cout << options << "\n";
+        return 0;
+    }
+
+    validate_gfa_overlaps(gfa_path, n_threads);
+
+    return 0;
+}
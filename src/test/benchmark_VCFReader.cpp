@@ -0,0 +1,199 @@
+#include "VCFReader.hpp"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <thread>
+
+using std::cerr;
+using std::ifstream;
+using std::ofstream;
+using std::stoi;
+
+
+void read_all_baseline(path vcf_path, map <string, vector <Variant> >& variants, uint16_t sample_number){
+    ///
+    /// The original parser, one ifstream::get() per character and stoi() per numeric field, kept here as a baseline
+    ///
+
+    ifstream vcf_file(vcf_path);
+    string token;
+    char c;
+
+    Variant variant;
+    uint8_t n_separators = 0;
+
+    auto parse_genotype = [&](){
+        while (vcf_file.get(c)){
+            if (c == '/' or c == '|' or c == '\n' or c == '\t'){
+                uint8_t allele = (token == ".") ? 0 : uint8_t(stoi(token));
+                token.resize(0);
+
+                if (c == '/' or c == '|') {
+                    variant.genotype.first = allele;
+                }
+                else{
+                    variant.genotype.second = allele;
+                    break;
+                }
+            }
+            else{
+                token += c;
+            }
+        }
+    };
+
+    while(vcf_file.get(c)){
+        if (c == '#'){
+            while(c != '\n'){
+                vcf_file.get(c);
+            }
+            token.resize(0);
+            continue;
+        }
+
+        if ((c == '\t') or (c == '\n') or (c == ',')){
+            if (n_separators == 0){
+                variant.chromosome = token;
+            }
+            else if (n_separators == 1){
+                variant.reference_start = uint64_t(stoi(token));
+            }
+            else if (n_separators == 3 or n_separators == 4){
+                variant.alleles.push_back(token);
+            }
+            else if (n_separators == 5){
+                variant.quality = uint8_t(stoi(token));
+            }
+            else if (n_separators == 6){
+                variant.pass = (token == "PASS");
+            }
+            else if (n_separators == (8 + sample_number)){
+                token.resize(0);
+                parse_genotype();
+            }
+
+            if (c == '\t' or c == '\n'){
+                n_separators++;
+            }
+
+            token.resize(0);
+
+            if (c == '\n'){
+                variants[variant.chromosome].push_back(variant);
+                variant = {};
+                n_separators = 0;
+            }
+        }
+        else {
+            token += c;
+        }
+    }
+}
+
+
+void write_scaled_vcf(path output_path, size_t n_records, size_t n_samples){
+    ///
+    /// Synthetic VCF in the shape of data/test.vcf, with realistic INFO and FORMAT columns and many samples, since
+    /// those are the bulk of real callsets even though only one sample is parsed
+    ///
+
+    ofstream file(output_path);
+    file << "##fileformat=VCFv4.2\n";
+    file << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT";
+    for (size_t s=0; s<n_samples; s++){
+        file << "\tHG" << s;
+    }
+    file << '\n';
+
+    const char* alleles[4][2] = {{"G","GTTT"}, {"T","TCC"}, {"GGAG","G"}, {"ATTA","A,AT"}};
+    // No commas in the sample columns: the baseline mistakes a comma in the column before the sample for its start
+    const char* genotypes[4] = {"0|1:35:23", "1/1:41:41", "0/0:12:12", "1|0:30:16"};
+
+    for (size_t i=0; i<n_records; i++){
+        auto& a = alleles[i % 4];
+
+        file << "chr" << (1 + i*22/n_records) << '\t' << 1000 + i*37 << "\t.\t" << a[0] << '\t' << a[1] << '\t'
+             << 20 + i % 40 << "\tPASS\tSVTYPE=INS;SVLEN=" << 3 + i % 50 << ";END=" << 1000 + i*37 << "\tGT:GQ:DP";
+
+        for (size_t s=0; s<n_samples; s++){
+            file << '\t' << genotypes[(i + s) % 4];
+        }
+        file << '\n';
+    }
+}
+
+
+bool are_equal(map <string, vector <Variant> >& a, map <string, vector <Variant> >& b){
+    if (a.size() != b.size()){
+        return false;
+    }
+
+    for (auto& [chromosome, variants]: a){
+        auto& other = b[chromosome];
+
+        if (variants.size() != other.size()){
+            return false;
+        }
+
+        for (size_t i=0; i<variants.size(); i++){
+            if (variants[i].to_string() != other[i].to_string()){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+int main(int argc, char* argv[]){
+    ///
+    /// Usage: benchmark_VCFReader [n_records] [n_samples] [n_threads]
+    ///
+
+    size_t n_records = (argc > 1) ? std::stoul(argv[1]) : 1000000;
+    size_t n_samples = (argc > 2) ? std::stoul(argv[2]) : 10;
+    size_t n_threads = (argc > 3) ? std::stoul(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+
+    path vcf_path = std::experimental::filesystem::temp_directory_path() / "benchmark_VCFReader.vcf";
+    write_scaled_vcf(vcf_path, n_records, n_samples);
+
+    double megabytes = double(std::experimental::filesystem::file_size(vcf_path))/1e6;
+    cerr << "Generated " << n_records << " records, " << n_samples << " samples, " << megabytes << " MB\n";
+
+    // Parse the last sample, so that both parsers have to get through every column
+    uint16_t sample_number = uint16_t(n_samples - 1);
+
+    auto time = [&](const string& name, const std::function<void(map <string, vector <Variant> >&)>& parse){
+        map <string, vector <Variant> > variants;
+
+        auto start = std::chrono::steady_clock::now();
+        parse(variants);
+        auto stop = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        cerr << name << '\t' << seconds << " s\t" << megabytes/seconds << " MB/s\n";
+
+        return variants;
+    };
+
+    auto baseline_variants = time("baseline", [&](map <string, vector <Variant> >& variants){
+        read_all_baseline(vcf_path, variants, sample_number);
+    });
+
+    auto variants = time("VCFReader", [&](map <string, vector <Variant> >& variants){
+        VCFReader reader(vcf_path);
+        reader.read_all(variants, sample_number);
+    });
+
+    auto parallel_variants = time("VCFReader, " + std::to_string(n_threads) + " threads", [&](map <string, vector <Variant> >& variants){
+        VCFReader reader(vcf_path);
+        reader.read_all(variants, sample_number, n_threads);
+    });
+
+    cerr << "Identical: " << are_equal(baseline_variants, variants) << '\t' << are_equal(variants, parallel_variants) << '\n';
+
+    std::experimental::filesystem::remove(vcf_path);
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+#include "BinaryIO.hpp"
+#include "MappedFile.hpp"
+#include <experimental/filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+using std::experimental::filesystem::path;
+using std::experimental::filesystem::temp_directory_path;
+using std::experimental::filesystem::remove;
+using std::ifstream;
+using std::ofstream;
+using std::cerr;
+using std::string;
+
+
+void read_test_values(BinaryReader& reader){
+    uint32_t a;
+    double b;
+    uint64_t c;
+    int64_t d;
+    int64_t e;
+    string f;
+    vector <uint16_t> g;
+
+    reader.read_value(a);
+    reader.read_value(b);
+    cerr << a << '\t' << b << '\t' << reader.tell() << '\n';
+
+    reader.read_varint(c);
+    reader.read_zigzag(d);
+    reader.read_zigzag(e);
+    cerr << c << '\t' << d << '\t' << e << '\t' << reader.tell() << '\n';
+
+    reader.read_string(f);
+    reader.read_vector(g);
+    cerr << f << '\t' << g.size() << '\t' << g.front() << '\t' << g.back() << '\t' << reader.tell() << '\n';
+
+    cerr << "at end: " << reader.at_end() << '\n';
+
+    try {
+        reader.read_value(a);
+    }
+    catch (runtime_error& error){
+        cerr << error.what() << '\n';
+    }
+}
+
+
+int main(){
+    path test_path = temp_directory_path() / "test_BinaryIO.bin";
+
+    // A tiny buffer, so that values straddle buffer boundaries on both sides
+    {
+        ofstream file(test_path, std::ios::binary);
+        BinaryWriter writer(file, 16);
+
+        vector <uint16_t> values;
+        for (uint16_t i=0; i<1000; i++){
+            values.emplace_back(i*3);
+        }
+
+        writer.write_value(uint32_t(0xDEADBEEF));
+        writer.write_value(3.25);
+        writer.write_varint(300);
+        writer.write_zigzag(-1);
+        writer.write_zigzag(-1234567890123);
+        writer.write_string("a length prefixed string");
+        writer.write_vector(values);
+
+        cerr << "bytes written: " << writer.tell() << '\n';
+    }
+
+    cerr << "TESTING stream\n";
+    ifstream file(test_path, std::ios::binary);
+    BinaryReader stream_reader(file, 16);
+    read_test_values(stream_reader);
+
+    cerr << "TESTING pread\n";
+    int file_descriptor = ::open(test_path.c_str(), O_RDONLY);
+    BinaryReader pread_reader(file_descriptor, 0, 16);
+    read_test_values(pread_reader);
+    ::close(file_descriptor);
+
+    cerr << "TESTING mmap\n";
+    {
+        MappedFile mapped_file(test_path);
+        BinaryReader memory_reader(mapped_file.data, mapped_file.size);
+        read_test_values(memory_reader);
+    }
+
+    remove(test_path);
+
+    return 0;
+}
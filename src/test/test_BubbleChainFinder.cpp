@@ -0,0 +1,54 @@
+#include <BubbleChainFinder.hpp>
+#include <iostream>
+#include <string>
+
+using std::cerr;
+using std::string;
+
+
+int main(){
+    path script_path = __FILE__;
+    path project_directory = script_path.parent_path().parent_path().parent_path();
+
+    // Three components: a chain of two parallel bubbles, a bubble with an edge inside it followed by a plain link,
+    // and a bubble with one reversed segment
+    path relative_gfa_path = "data/test_bubbles.gfa";
+    path absolute_gfa_path = project_directory / relative_gfa_path;
+
+    GFAReader gfa_reader(absolute_gfa_path);
+
+    for (size_t n_threads: {1, 4}){
+        cerr << "TESTING " << relative_gfa_path << " with " << n_threads << " threads\n";
+
+        BubbleChainFinder finder(gfa_reader, n_threads);
+        vector <vector <BubbleChainComponent> > chains;
+
+        finder.find_bubble_chains(chains);
+
+        for (auto& chain: chains){
+            for (auto& component: chain){
+                cerr << component.to_string() << '\n';
+            }
+            cerr << '\n';
+        }
+    }
+
+    // With a limit smaller than the bubbles only the plain link 12 -> 13 is found, and the searches that gave up are
+    // counted
+    cerr << "TESTING " << relative_gfa_path << " with max_bubble_size 1\n";
+
+    BubbleChainFinder limited_finder(gfa_reader, 1, 1);
+    vector <vector <BubbleChainComponent> > chains;
+    size_t n_abandoned_entrances;
+
+    limited_finder.find_bubble_chains(chains, n_abandoned_entrances);
+
+    for (auto& chain: chains){
+        for (auto& component: chain){
+            cerr << component.to_string() << '\n';
+        }
+    }
+    cerr << n_abandoned_entrances << " abandoned entrances\n";
+
+    return 0;
+}
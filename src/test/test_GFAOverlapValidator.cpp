@@ -0,0 +1,57 @@
+#include <GFAOverlapValidator.hpp>
+#include <iostream>
+#include <string>
+
+using std::cerr;
+using std::string;
+
+
+int main(){
+    path script_path = __FILE__;
+    path project_directory = script_path.parent_path().parent_path().parent_path();
+
+    // One link per orientation pair, with overlaps of 18 to 33 bases so that both the 16 byte comparison and the tail
+    // comparison are used. Expected mismatches: a+b+ 0, a+c+ 2 (one in each part), a+d- 1, e-f- 3, g-a+ 0, and a+h+ 0
+    // with a 2 base insertion.
+    path relative_gfa_path = "data/test_overlaps.gfa";
+    path absolute_gfa_path = project_directory / relative_gfa_path;
+
+    GFAReader gfa_reader(absolute_gfa_path);
+
+    cerr << "TESTING " << relative_gfa_path << '\n';
+
+    GFAOverlapValidator validator(gfa_reader, 1);
+    OverlapValidation validation;
+
+    for (auto line_index: gfa_reader.line_indexes_by_type.at('L')){
+        validator.validate_link(line_index, validation);
+
+        cerr << validation.node_a << '\t' << validation.node_b << '\t' << validation.get_link_string() << '\n';
+        cerr << "true:\t" << validation.true_stats.to_string() << '\n';
+        cerr << "gfa:\t" << validation.gfa_stats.to_string() << '\n';
+
+        if (not validation.is_valid()){
+            cerr << validation.alignment << '\n';
+        }
+        cerr << '\n';
+    }
+
+    // The parallel pass must report the same links, in GFA order
+    for (size_t n_threads: {1, 4}){
+        cerr << "TESTING validate() with " << n_threads << " threads\n";
+
+        GFAOverlapValidator parallel_validator(gfa_reader, n_threads);
+        CigarStats total_true_stats;
+        CigarStats total_gfa_stats;
+
+        parallel_validator.validate([&](const OverlapValidation& result){
+            cerr << result.node_a << '\t' << result.node_b << '\t' << result.true_stats.n_mismatches << '\n';
+        }, total_true_stats, total_gfa_stats);
+
+        cerr << "true:\t" << total_true_stats.to_string() << '\n';
+        cerr << "gfa:\t" << total_gfa_stats.to_string() << '\n';
+        cerr << '\n';
+    }
+
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include <GFAReader.hpp>
+#include <GFAIndexer.hpp>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 using std::cerr;
 using std::cerr;
@@ -17,7 +19,7 @@ int main(){
     GFAReader reader(absolute_gfa_path);
 
     for (auto& [gfa_type_code, indexes]: reader.line_indexes_by_type){
-        for (auto& i: indexes) {
+        for (auto i: indexes) {
             cerr << gfa_type_code << '\t' << i << '\t' << reader.line_offsets[i].offset << '\n';
         }
     }
@@ -60,6 +62,235 @@ int main(){
 
     reader.write_link_subset_to_file(nodes, o);
 
+    cerr << "TESTING node handles\n";
+    for (NodeHandle h=0; h<reader.get_node_count(); h++){
+        cerr << h << '\t' << reader.get_node_name(h) << '\t' << reader.get_sequence_length(h) << '\n';
+    }
+
+    cerr << reader.get_node_handle("12") << '\t' << reader.get_node_handle(int64_t(12)) << '\n';
+
+    cerr << "TESTING adjacency\n";
+    for (NodeHandle h=0; h<reader.get_node_count(); h++){
+        for (auto& edge: reader.get_edges(h)){
+            cerr << reader.get_node_name(h) << (edge.reversed ? '-' : '+') << " -> "
+                 << reader.get_node_name(edge.neighbor) << (edge.neighbor_reversed ? '-' : '+') << '\t'
+                 << edge.overlap_length << '\t' << edge.line_index << '\n';
+        }
+    }
+
+    cerr << "TESTING neighborhood\n";
+    vector <NodeHandle> neighborhood;
+    vector <NodeHandle> seeds = {reader.get_node_handle("11")};
+
+    for (uint64_t max_hops: {uint64_t(0), uint64_t(1)}){
+        reader.get_neighborhood(seeds, max_hops, GFAReader::NO_LIMIT, neighborhood);
+        cerr << "hops " << max_hops << ':';
+        for (auto& h: neighborhood){
+            cerr << ' ' << reader.get_node_name(h);
+        }
+        cerr << '\n';
+    }
+
+    reader.get_neighborhood({reader.get_node_handle("13")}, GFAReader::NO_LIMIT, 5, neighborhood);
+    cerr << "radius 5:";
+    for (auto& h: neighborhood){
+        cerr << ' ' << reader.get_node_name(h);
+    }
+    cerr << '\n';
+
+    // 6 is 3 hops and 110 bp away through 1-2-5, but the shortest path in bp to 5 (1-3-4) already uses 3 hops
+    path detour_gfa_path = std::experimental::filesystem::temp_directory_path() / "test_detour.gfa";
+    std::experimental::filesystem::remove(path(detour_gfa_path).replace_extension("gfai"));
+    {
+        ofstream detour_gfa(detour_gfa_path);
+        detour_gfa << "S\t1\tA\n";
+        detour_gfa << "S\t2\t" << string(100, 'A') << '\n';
+        detour_gfa << "S\t3\tA\n";
+        detour_gfa << "S\t4\tA\n";
+        detour_gfa << "S\t5\t" << string(10, 'A') << '\n';
+        detour_gfa << "S\t6\tA\n";
+        detour_gfa << "L\t1\t+\t2\t+\t0M\n";
+        detour_gfa << "L\t2\t+\t5\t+\t0M\n";
+        detour_gfa << "L\t5\t+\t6\t+\t0M\n";
+        detour_gfa << "L\t1\t+\t3\t+\t0M\n";
+        detour_gfa << "L\t3\t+\t4\t+\t0M\n";
+        detour_gfa << "L\t4\t+\t5\t+\t0M\n";
+    }
+
+    GFAReader detour_reader(detour_gfa_path);
+    detour_reader.get_neighborhood({detour_reader.get_node_handle("1")}, 3, 5000, neighborhood);
+    cerr << "hops 3 radius 5000:";
+    for (auto& h: neighborhood){
+        cerr << ' ' << detour_reader.get_node_name(h);
+    }
+    cerr << '\n';
+
+    detour_reader.get_neighborhood({detour_reader.get_node_handle("1")}, 3, 100, neighborhood);
+    cerr << "hops 3 radius 100:";
+    for (auto& h: neighborhood){
+        cerr << ' ' << detour_reader.get_node_name(h);
+    }
+    cerr << '\n';
+
+    cerr << "TESTING BGZF\n";
+    GFAReader compressed_reader(project_directory / "data/test_gfa1.gfa.bgz");
+
+    cerr << compressed_reader.bgzf_reader->get_block_count() << " blocks\n";
+    for (size_t i=0; i+1<compressed_reader.line_offsets.size(); i++){
+        compressed_reader.read_line(s, i);
+        cerr << compressed_reader.line_offsets[i].offset << '\t' << compressed_reader.get_line_virtual_offset(i) << '\t' << s;
+    }
+
+    string uncompressed_line;
+    reader.read_line(uncompressed_line, reader.get_sequence_line_index(reader.get_node_handle("13")));
+    compressed_reader.read_line(s, compressed_reader.get_sequence_line_index(compressed_reader.get_node_handle("13")));
+    cerr << "Same as uncompressed: " << (s == uncompressed_line) << '\n';
+
+    cerr << "TESTING batch\n";
+    GFALineBatch batch;
+    reader.read_lines({6, 1, 3, 1, 2}, batch);
+    cerr << batch.n_reads << " reads\n";
+    for (auto& line: batch.lines){
+        cerr << line;
+    }
+
+    compressed_reader.read_lines({6, 1, 3, 1, 2}, batch);
+    for (auto& line: batch.lines){
+        cerr << line;
+    }
+
+    cerr << "TESTING compressed offsets\n";
+    vector <uint64_t> values;
+    for (uint64_t i=0; i<100000; i++){
+        values.emplace_back(i*i/7 + (i % 13)*(i > 0));
+    }
+    std::sort(values.begin(), values.end());
+
+    vector <uint64_t> words;
+    EliasFano elias_fano;
+    EliasFano::encode(values.data(), values.size(), words);
+    elias_fano.load({words.data(), words.size()});
+
+    bool all_equal = true;
+    for (size_t i=0; i<values.size(); i++){
+        all_equal = all_equal and (elias_fano[i] == values[i]);
+    }
+    cerr << "Elias-Fano matches: " << all_equal << '\t' << words.size()*64.0/values.size() << " bits per value\n";
+
+    // The compressed index of a copy of the GFA must serve exactly the same lines
+    path compressed_gfa_path = std::experimental::filesystem::temp_directory_path() / "test_gfa1_compressed.gfa";
+    std::experimental::filesystem::copy_file(absolute_gfa_path, compressed_gfa_path, std::experimental::filesystem::copy_options::overwrite_existing);
+    std::experimental::filesystem::remove(path(compressed_gfa_path).replace_extension("gfai"));
+
+    GFAReader compressed_offset_reader(compressed_gfa_path, 1, true);
+    cerr << compressed_offset_reader.line_offsets.offsets.is_compressed << '\n';
+
+    for (auto& [gfa_type_code, indexes]: compressed_offset_reader.line_indexes_by_type){
+        for (auto i: indexes){
+            compressed_offset_reader.read_line(s, i);
+            cerr << gfa_type_code << '\t' << i << '\t' << s;
+        }
+    }
+
+    std::experimental::filesystem::remove(compressed_gfa_path);
+    std::experimental::filesystem::remove(path(compressed_gfa_path).replace_extension("gfai"));
+
+    cerr << "TESTING tags\n";
+    GFAReader shasta_reader(project_directory / "data/Assembly-BothStrands_3548768-2173486-464300_r20.gfa");
+
+    auto& coverage = shasta_reader.get_tag_column('S', "RC", 'i');
+    auto& length = shasta_reader.get_tag_column('S', "LN", 'i');
+    for (NodeHandle h=0; h<5; h++){
+        cerr << shasta_reader.get_node_name(h) << '\t' << coverage.get_integer(h) << '\t' << length.get_integer(h) << '\t' << shasta_reader.get_sequence_length(h) << '\n';
+    }
+
+    auto& link_lengths = shasta_reader.get_tag_column('L', "L1", 'i');
+    auto& missing = shasta_reader.get_tag_column('L', "XX", 'Z');
+    for (size_t i=0; i<3; i++){
+        shasta_reader.read_line(s, shasta_reader.line_indexes_by_type.at('L')[i]);
+        cerr << link_lengths.get_integer(i) << '\t' << missing.has_value(i) << '\t' << s;
+    }
+
+    // A second reader finds the columns in the index instead of parsing the GFA again
+    GFAReader shasta_reader_2(project_directory / "data/Assembly-BothStrands_3548768-2173486-464300_r20.gfa");
+    cerr << shasta_reader_2.index_file->has_section(get_tag_column_section('S', "RC", 'i', TAG_PRESENT)) << '\t'
+         << shasta_reader_2.get_tag_column('S', "RC", 'i').get_integer(0) << '\n';
+
+    cerr << "TESTING sequence store\n";
+    path iupac_gfa_path = std::experimental::filesystem::temp_directory_path() / "test_iupac.gfa";
+    std::experimental::filesystem::remove(path(iupac_gfa_path).replace_extension("gfai"));
+    {
+        ofstream iupac_gfa(iupac_gfa_path);
+        iupac_gfa << "S\tb\tACGTNNacgtRYACGTACGTACGTACGTACGTACGTACGT\n";
+        iupac_gfa << "S\ta\tTTTTG\n";
+        iupac_gfa << "S\tc\t*\n";
+        iupac_gfa << "L\ta\t+\td\t+\t0M\n";
+    }
+
+    GFAReader iupac_reader(iupac_gfa_path);
+    auto& sequences = iupac_reader.get_sequence_store();
+    for (NodeHandle h=0; h<iupac_reader.get_node_count(); h++){
+        sequences.get_sequence(h, s);
+        cerr << iupac_reader.get_node_name(h) << '\t' << sequences.get_length(h) << '\t' << s << '\n';
+    }
+
+    NodeHandle handle_b;
+    iupac_reader.find_node_handle("b", handle_b);
+    sequences.get_sequence(handle_b, 2, 10, false, s);
+    cerr << s << '\t';
+    sequences.get_sequence(handle_b, 2, 10, true, s);
+    cerr << s << '\n';
+
+    // Stores of the large GFA must match its S lines, and be found in the index by a second reader
+    auto& shasta_sequences = shasta_reader.get_sequence_store();
+    bool all_sequences_equal = true;
+    vector <string_view> fields;
+
+    for (NodeHandle h=0; h<shasta_reader.get_node_count(); h++){
+        string line;
+        shasta_reader.read_line(line, shasta_reader.get_sequence_line_index(h));
+        split_gfa_line(line, fields, 4);
+        shasta_sequences.get_sequence(h, s);
+        all_sequences_equal = all_sequences_equal and (s == fields[2]);
+    }
+
+    GFAReader shasta_reader_3(project_directory / "data/Assembly-BothStrands_3548768-2173486-464300_r20.gfa");
+    cerr << all_sequences_equal << '\t' << shasta_reader_3.index_file->has_section(SEQUENCE_PACKED) << '\t'
+         << shasta_reader_3.get_sequence_store().get_base_count() << '\t' << shasta_sequences.get_base_count() << '\n';
+
+    std::experimental::filesystem::remove(iupac_gfa_path);
+    std::experimental::filesystem::remove(path(iupac_gfa_path).replace_extension("gfai"));
+
+    cerr << "TESTING sections added by two readers\n";
+    path tagged_gfa_path = std::experimental::filesystem::temp_directory_path() / "test_tagged.gfa";
+    path tagged_index_path = path(tagged_gfa_path).replace_extension("gfai");
+    std::experimental::filesystem::remove(tagged_index_path);
+    {
+        ofstream tagged_gfa(tagged_gfa_path);
+        tagged_gfa << "S\ta\tACGT\tRC:i:7\tXC:Z:red\n";
+        tagged_gfa << "S\tb\tTT\tRC:i:3\tXC:Z:blue\n";
+        tagged_gfa << "L\ta\t+\tb\t+\t0M\n";
+    }
+
+    // Both readers map the index before either adds a section, so neither mapping contains the other's section
+    GFAReader tagged_reader_a(tagged_gfa_path);
+    GFAReader tagged_reader_b(tagged_gfa_path);
+
+    tagged_reader_a.get_tag_column('S', "RC", 'i');
+    tagged_reader_b.get_tag_column('S', "XC", 'Z');
+    tagged_reader_b.get_sequence_store();
+
+    GFAReader tagged_reader_c(tagged_gfa_path);
+    auto& colors = tagged_reader_c.get_tag_column('S', "XC", 'Z');
+    cerr << tagged_reader_c.index_file->has_section(get_tag_column_section('S', "RC", 'i', TAG_PRESENT)) << '\t'
+         << tagged_reader_c.index_file->has_section(get_tag_column_section('S', "XC", 'Z', TAG_PRESENT)) << '\t'
+         << tagged_reader_c.index_file->has_section(SEQUENCE_PACKED) << '\t'
+         << tagged_reader_c.get_tag_column('S', "RC", 'i').get_integer(0) << '\t'
+         << colors.get_string(1) << '\t'
+         << tagged_reader_c.get_sequence_store().get_base_count() << '\n';
+
+    std::experimental::filesystem::remove(tagged_gfa_path);
+    std::experimental::filesystem::remove(tagged_index_path);
 
 
     return 0;
@@ -0,0 +1,38 @@
+#include <GFAStream.hpp>
+#include <iostream>
+#include <string>
+
+using std::cerr;
+using std::string;
+
+
+int main(){
+    path script_path = __FILE__;
+    path project_directory = script_path.parent_path().parent_path().parent_path();
+
+    // The same graph, uncompressed and BGZF compressed, should stream identically
+    for (path relative_gfa_path: {"data/test_gfa1.gfa", "data/test_gfa1.gfa.bgz"}){
+        path absolute_gfa_path = project_directory / relative_gfa_path;
+
+        cerr << "TESTING " << relative_gfa_path << '\n';
+
+        GFAStream stream(absolute_gfa_path, 16);
+
+        stream.set_handler('S', [&](string_view line, const vector <string_view>& fields){
+            cerr << "S\t" << fields[1] << '\t' << fields[2].size() << '\n';
+        });
+
+        stream.set_handler('L', [&](string_view line, const vector <string_view>& fields){
+            cerr << "L\t" << fields[1] << fields[2] << " -> " << fields[3] << fields[4] << '\t' << fields[5] << '\n';
+        });
+
+        stream.set_default_handler([&](string_view line, const vector <string_view>& fields){
+            cerr << "other\t" << line << '\n';
+        });
+
+        auto n_lines = stream.stream();
+        cerr << n_lines << " lines\n";
+    }
+
+    return 0;
+}
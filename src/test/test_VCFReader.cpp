@@ -1,7 +1,9 @@
 #include "VCFReader.hpp"
 #include <iostream>
+#include <tuple>
 
 using std::cout;
+using std::tuple;
 
 int main() {
     path script_path = __FILE__;
@@ -33,5 +35,144 @@ int main() {
         }
     }
 
-}
+    cout << "\n\n";
+
+    // Streaming, one record at a time, with a notification at every change of chromosome
+    reader.set_chromosome_change_handler([&](const string& previous_chromosome, const string& next_chromosome){
+        cout << "Chromosome change: '" << previous_chromosome << "' -> '" << next_chromosome << "'\n";
+    });
+
+    reader.rewind();
+
+    Variant variant;
+    while (reader.next(variant, 1)) {
+        cout << variant.to_string() << '\n';
+    }
+
+    cout << "\n\n";
+
+    // Region queries on a sorted, BGZF compressed copy, which are served from a .vcfi built on first use
+    path compressed_vcf_path = project_directory / "data/test_sorted.vcf.bgz";
+    std::experimental::filesystem::remove(compressed_vcf_path.string() + ".vcfi");
+
+    VCFReader compressed_reader(compressed_vcf_path);
+    cout << compressed_reader.bgzf_reader->get_block_count() << " blocks\n";
+
+    auto print_variant = [&](const Variant& v){
+        cout << Variant(v).to_string() << '\n';
+    };
+
+    compressed_reader.query("chr1", 1, 100, print_variant, 1);
+    cout << '\n';
+    compressed_reader.query("chr2", 6, 6, print_variant, 1);
+    cout << '\n';
+    compressed_reader.query("chr2", 9, 9, print_variant, 1);
+    cout << '\n';
+    compressed_reader.query("chr3", 1, 100, print_variant, 1);
+    cout << '\n';
+
+    // A second reader takes the block table from the index
+    VCFReader compressed_reader_2(compressed_vcf_path);
+    cout << (compressed_reader_2.index != nullptr) << '\n';
+    compressed_reader_2.for_each(print_variant, 1, 2);
+
+    // Unsorted VCFs can't be indexed
+    try {
+        reader.query("chr1", 1, 100, print_variant);
+    }
+    catch (runtime_error& e){
+        cout << e.what() << '\n';
+    }
+
+    cout << "\n\n";
+
+    // Records spread over several 16 kb windows of the index: windows with no record in them, REFs that reach into
+    // later windows (chrA:98200 crosses a window boundary, chrB:40000 spans three windows), and queries that start
+    // past the last window. Every query is compared to a scan of all records.
+    path windows_vcf_path = project_directory / "data/test_windows.vcf.bgz";
+    std::experimental::filesystem::remove(windows_vcf_path.string() + ".vcfi");
+
+    VCFReader windows_reader(windows_vcf_path);
+    vector <Variant> all_records;
+    windows_reader.for_each([&](const Variant& v){
+        all_records.emplace_back(v);
+    });
+
+    vector <tuple <string, uint64_t, uint64_t> > regions = {
+            {"chrA", 30000, 60000},
+            {"chrA", 98400, 98410},
+            {"chrA", 98305, 98305},
+            {"chrA", 99000, 119999},
+            {"chrA", 130000, 140000},
+            {"chrA", 1, 200000},
+            {"chrB", 60000, 60001},
+            {"chrB", 79999, 100000},
+            {"chrB", 80000, 99999},
+            {"chrC", 1, 100}
+    };
+
+    for (auto& [chromosome, start, stop]: regions){
+        vector <uint64_t> positions;
+        vector <uint64_t> expected_positions;
+
+        windows_reader.query(chromosome, start, stop, [&](const Variant& v){
+            positions.emplace_back(v.reference_start);
+        }, 0, 2);
 
+        for (auto& v: all_records){
+            if (v.chromosome == chromosome and v.reference_start <= stop and v.reference_start + v.alleles[0].size() > start){
+                expected_positions.emplace_back(v.reference_start);
+            }
+        }
+
+        cout << chromosome << ':' << start << '-' << stop << '\t' << (positions == expected_positions);
+        for (auto& position: positions){
+            cout << '\t' << position;
+        }
+        cout << '\n';
+    }
+
+    std::experimental::filesystem::remove(windows_vcf_path.string() + ".vcfi");
+
+    cout << "\n\n";
+
+    // Genotypes of every sample, extracted in one pass into a columnar matrix
+    vector <string> sample_names;
+    reader.get_sample_names(sample_names);
+
+    vector <uint16_t> sample_numbers;
+    for (size_t i=0; i<sample_names.size(); i++){
+        sample_numbers.emplace_back(uint16_t(i));
+    }
+
+    vector <Variant> records;
+    GenotypeMatrix genotypes(sample_numbers);
+    reader.read_genotypes(records, genotypes, 2);
+
+    for (size_t r=0; r<records.size(); r++){
+        cout << records[r].chromosome << '\t' << records[r].reference_start;
+
+        for (size_t s=0; s<genotypes.get_sample_count(); s++){
+            char separator = genotypes.is_phased(r, s) ? '|' : '/';
+            cout << '\t' << sample_names[s] << '=' << int(genotypes.get_allele(r, s, 0)) << separator << int(genotypes.get_allele(r, s, 1));
+        }
+        cout << '\n';
+    }
+
+    // Alleles are stored in 8 bits, so larger allele indexes must not wrap around to the reference
+    for (string field: {"255|1:30", "./2", "0|256:30"}){
+        uint8_t first;
+        uint8_t second;
+        uint8_t flags;
+
+        try {
+            VCFReader::parse_genotype(field, first, second, flags);
+            cout << field << '\t' << int(first) << '\t' << int(second) << '\t' << int(flags) << '\n';
+        }
+        catch (runtime_error& e){
+            cout << e.what() << '\n';
+        }
+    }
+
+    std::experimental::filesystem::remove(compressed_vcf_path.string() + ".vcfi");
+}